@@ -21,11 +21,39 @@
 #include <map>
 #include <vector>
 #include <deque>
+#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
 #include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <optional>
+#include <numeric>
+#include <ctime>
 #include <sstream>
+#include <string_view>
 #include <termios.h>
 #include <unistd.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 enum ConsoleColorCode
 {
@@ -53,18 +81,30 @@ class ConsoleColorModifier
 {
 protected:
     ConsoleColorCode    mCode;
+    char                mSequence[8];   // "\033[<code>m", built once
+    size_t              mLength;
     typedef ConsoleColorModifier ThisType;
 
 public:
-    ConsoleColorModifier(ConsoleColorCode code) : mCode(code) {}
-    virtual ~ConsoleColorModifier() {}
+    static bool         enabled;    // false to print plain text
+
+    ConsoleColorModifier(ConsoleColorCode code) : mCode(code)
+    {
+        mLength = snprintf(mSequence, sizeof(mSequence), "\033[%dm", int(code));
+    }
+
+    // the escape sequence, empty while colors are disabled
+    std::string_view    sequence() const { return std::string_view(mSequence, enabled ? mLength : 0); }
 
     friend std::ostream& operator<<(std::ostream& os, const ThisType& mod)
     {
-        return os << "\033[" << mod.mCode << "m";
+        std::string_view seq = mod.sequence();
+        return os.write(seq.data(), seq.size());
     }
 };
 
+bool ConsoleColorModifier::enabled = true;
+
 ConsoleColorModifier
     FRONT_BLACK(FG_BLACK),
     FRONT_RED(FG_RED),
@@ -89,25 +129,392 @@ ConsoleColorModifier
     BACK_DEFAULT(BG_DEFAULT)
 ;
 
-std::string getWordClass(const std::string &c)
+// measures a step: nanoseconds since construction or the last lap
+class Stopwatch
+{
+    std::chrono::steady_clock::time_point mStart = std::chrono::steady_clock::now();
+
+public:
+    uint64_t            lap()
+    {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - mStart).count();
+        mStart = now;
+        return ns;
+    }
+};
+
+// problems the dict parsers report, by kind
+enum parse_issue : uint8_t
+{
+    pi_expected_block,
+    pi_expected_entity,
+    pi_different_words,
+    pi_expected_indicator,
+    pi_expected_title,
+    pi_expected_item_end,
+    pi_expected_content,
+    pi_blank_content,           // warnings from here on
+    pi_content_ended_colon,
+    pi_content_ended_bracket,
+    pi_unknown_item,
+    pi_bad_class,
+    parse_issue_count
+};
+
+static const char *const parse_issue_names[parse_issue_count] = {
+    "expected_block", "expected_entity", "different_words", "expected_indicator", "expected_title",
+    "expected_item_end", "expected_content", "blank_content", "content_ended_colon",
+    "content_ended_bracket", "unknown_item", "bad_class"
+};
+
+static const char *const parse_issue_messages[parse_issue_count] = {
+    "expected begin of word block.",
+    "expected word entity.",
+    "trying to merge different words.",
+    "expected item indicator.",
+    "expected item title.",
+    "expected item end.",
+    "expected item content.",
+    "warning: blank item content.",
+    "warning: item content unexpectedly ended with ':'.",
+    "warning: item content unexpectedly ended with ']'.",
+    "unrecognized item, ignored.",
+    "wrong bracket order, treat as unknown class."
+};
+
+// time spent in the steps of opening and saving a dictionary
+enum stat_timer : uint8_t
+{
+    st_load_io,         // reading or mapping dict
+    st_load_parse,      // parsing it, merging duplicates
+    st_snapshot_open,
+    st_journal_replay,
+    st_save_backup,
+    st_save_serialize,
+    st_save_write,
+    st_save_snapshot,
+    st_autosave,        // folding the journal into dict in the background
+    stat_timer_count
+};
+
+enum stat_counter : uint8_t
+{
+    sc_records,         // word blocks read from dict
+    sc_merges,          // blocks folded into an earlier one of the same head word
+    sc_bad_records,
+    sc_load_faults,     // major page faults while loading
+    sc_journal_records,
+    sc_saves,
+    sc_lazy_records,    // blocks parsed on demand by a LazyStore
+    sc_autosaves,
+    stat_counter_count
+};
+
+// commands whose latency is recorded
+enum stat_command : uint8_t
+{
+    sc_lookup,
+    sc_prefix,
+    sc_add,
+    sc_remove,
+    sc_search,
+    sc_category,
+    stat_command_count
+};
+
+static const char *const stat_command_names[stat_command_count] = {
+    "lookup", "prefix", "add", "remove", "search", "category"
+};
+
+// counters of where a session spends its time, kept in relaxed atomics so
+// they can stay on everywhere, threads included. latencies, recorded on
+// every request, go to a shard of the recording thread and are only summed
+// up by report(). printed on exit with --stats and answered to the
+// daemon's stats request.
+class Stats
 {
-    std::vector<const char*> classes = {
-        "n", "noun",
-        "pron", "pronoun",
-        "v", "verb",
-        "adj", "adjective",
-        "adv", "adverb",
-        "prep", "preposition",
-        "conj", "conjunction"
+    // latencies by powers of two: bucket b counts those below 2^b ns
+    static const size_t     buckets = 40;
+
+    // latencies recorded by one thread, the only one writing them
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t>   latency[stat_command_count][buckets] = {};
+        std::atomic<uint64_t>   sum[stat_command_count] = {};
+        Shard                   *next = nullptr;
     };
-    for(size_t i = 0; i < classes.size(); ++i)
+
+    std::atomic<uint64_t>   mIssues[parse_issue_count] = {};
+    std::atomic<uint64_t>   mTimers[stat_timer_count] = {};
+    std::atomic<uint64_t>   mCounters[stat_counter_count] = {};
+    std::atomic<Shard *>    mShards{nullptr};   // of every thread that recorded one, kept after it exits
+
+    // the shard of the calling thread, added on its first latency
+    Shard                  &shard()
+    {
+        thread_local Shard *mine = nullptr;
+        if(!mine)
+        {
+            mine = new Shard;
+            mine->next = mShards.load();
+            while(!mShards.compare_exchange_weak(mine->next, mine));
+        }
+        return *mine;
+    }
+
+    // no other thread writes a shard's counters, so no locked add is needed
+    static void             add(std::atomic<uint64_t> &a, uint64_t n)
+    {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static std::string      duration(uint64_t ns)
+    {
+        char s[32];
+        if(ns < 1000) snprintf(s, sizeof(s), "%uns", unsigned(ns));
+        else if(ns < 1000000) snprintf(s, sizeof(s), "%.1fus", ns / 1e3);
+        else if(ns < 1000000000) snprintf(s, sizeof(s), "%.1fms", ns / 1e6);
+        else snprintf(s, sizeof(s), "%.2fs", ns / 1e9);
+        return s;
+    }
+
+public:
+    void                    issue(parse_issue i) { mIssues[i].fetch_add(1, std::memory_order_relaxed); }
+    void                    time(stat_timer t, uint64_t ns) { mTimers[t].fetch_add(ns, std::memory_order_relaxed); }
+    void                    count(stat_counter c, uint64_t n = 1) { mCounters[c].fetch_add(n, std::memory_order_relaxed); }
+    uint64_t                counter(stat_counter c) const { return mCounters[c].load(std::memory_order_relaxed); }
+
+    void                    latency(stat_command c, uint64_t ns)
+    {
+        size_t b = std::min<size_t>(ns ? 64 - __builtin_clzll(ns) : 0, buckets - 1);
+        Shard &s = shard();
+        add(s.latency[c][b], 1);
+        add(s.sum[c], ns);
+    }
+
+    void                    report(std::ostream &s) const
+    {
+        auto timer = [&](stat_timer t) { return duration(mTimers[t].load(std::memory_order_relaxed)); };
+        auto set = [&](stat_timer t) { return mTimers[t].load(std::memory_order_relaxed) != 0; };
+        if(set(st_load_io) || set(st_load_parse))
+        {
+            s << "load: io " << timer(st_load_io) << ", parse " << timer(st_load_parse) << "; "
+              << counter(sc_records) << " records, " << counter(sc_merges) << " merged, "
+              << counter(sc_bad_records) << " failed, " << counter(sc_load_faults) << " major page faults\n";
+        }
+        if(counter(sc_lazy_records)) s << "lazy: " << counter(sc_lazy_records) << " records parsed on demand\n";
+        if(set(st_snapshot_open)) s << "snapshot: opened in " << timer(st_snapshot_open) << "\n";
+        if(set(st_journal_replay))
+        {
+            s << "journal: " << counter(sc_journal_records) << " records replayed in " << timer(st_journal_replay) << "\n";
+        }
+        if(counter(sc_saves))
+        {
+            s << "save: " << counter(sc_saves) << "x, backup " << timer(st_save_backup) << ", serialize "
+              << timer(st_save_serialize) << ", write " << timer(st_save_write) << ", snapshot " << timer(st_save_snapshot) << "\n";
+        }
+        if(counter(sc_autosaves)) s << "autosave: " << counter(sc_autosaves) << "x in " << timer(st_autosave) << "\n";
+        for(int warnings = 0; warnings < 2; ++warnings)
+        {
+            std::string line;
+            for(size_t i = warnings ? pi_blank_content : 0; i < (warnings ? parse_issue_count : pi_blank_content); ++i)
+            {
+                uint64_t n = mIssues[i].load(std::memory_order_relaxed);
+                if(n) line += std::string(line.empty() ? "" : ", ") + parse_issue_names[i] + " " + std::to_string(n);
+            }
+            if(!line.empty()) s << "parser " << (warnings ? "warnings: " : "errors: ") << line << "\n";
+        }
+        for(size_t c = 0; c < stat_command_count; ++c)
+        {
+            uint64_t n = 0, sum = 0, counts[buckets] = {};
+            for(const Shard *part = mShards.load(); part; part = part->next)
+            {
+                for(size_t b = 0; b < buckets; ++b) counts[b] += part->latency[c][b].load(std::memory_order_relaxed);
+                sum += part->sum[c].load(std::memory_order_relaxed);
+            }
+            for(size_t b = 0; b < buckets; ++b) n += counts[b];
+            if(n == 0) continue;
+            // upper bound of the bucket holding the q-th latency
+            auto quantile = [&](double q) {
+                uint64_t seen = 0;
+                size_t b = 0;
+                for(; b + 1 < buckets && (seen += counts[b]) < q * n; ++b);
+                return "<" + duration(uint64_t(1) << b);
+            };
+            size_t last = buckets - 1;
+            while(counts[last] == 0) --last;
+            s << stat_command_names[c] << ": " << n << "x, mean " << duration(sum / n)
+              << ", p50 " << quantile(0.5) << ", p90 " << quantile(0.9) << ", p99 " << quantile(0.99)
+              << ", max " << quantile(1) << "\n ";
+            for(size_t b = 0; b <= last; ++b)
+                if(counts[b]) s << " <" << duration(uint64_t(1) << b) << " " << counts[b];
+            s << "\n";
+        }
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) == 0) s << "peak rss: " << usage.ru_maxrss / 1024 << " MiB\n";
+    }
+};
+
+static Stats stats;
+
+// takes the parser diagnostics of its thread while installed, instead of
+// std::cerr
+class ParseListener
+{
+public:
+    virtual ~ParseListener() {}
+    // pos is the position in the parsed buffer, npos if the parser does not know it
+    virtual void        issue(parse_issue i, size_t pos) = 0;
+};
+
+thread_local ParseListener *parse_listener = nullptr;
+
+// counts a parser diagnostic and prints it, or passes it to the listener
+void parseIssue(parse_issue i, size_t pos = std::string_view::npos)
+{
+    stats.issue(i);
+    if(parse_listener) parse_listener->issue(i, pos);
+    else std::cerr << parse_issue_messages[i] << std::endl;
+}
+
+// major page faults so far, they show the reads a mapped file costs
+uint64_t majorFaults()
+{
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_majflt : 0;
+}
+
+// word classes, declared in the alphabetical order of their names so that
+// definitions keyed by class keep sorting the way they did keyed by name
+enum WordClass : uint8_t
+{
+    wc_adjective,
+    wc_adverb,
+    wc_conjunction,
+    wc_determiner,
+    wc_interjection,
+    wc_noun,
+    wc_preposition,
+    wc_pronoun,
+    wc_unknown,
+    wc_verb,
+    word_class_count
+};
+
+constexpr const char *word_class_names[word_class_count] = {
+    "adjective",
+    "adverb",
+    "conjunction",
+    "determiner",
+    "interjection",
+    "noun",
+    "preposition",
+    "pronoun",
+    "unknown",
+    "verb"
+};
+
+struct WordClassAlias
+{
+    std::string_view    name;
+    WordClass           cls;
+};
+
+// every spelling accepted inside "(...)", add new ones here
+constexpr WordClassAlias word_class_aliases[] = {
+    {"n", wc_noun},             {"noun", wc_noun},
+    {"pron", wc_pronoun},       {"pronoun", wc_pronoun},
+    {"v", wc_verb},             {"verb", wc_verb},
+    {"vt", wc_verb},            {"vi", wc_verb},
+    {"adj", wc_adjective},      {"adjective", wc_adjective},
+    {"adv", wc_adverb},         {"adverb", wc_adverb},
+    {"prep", wc_preposition},   {"preposition", wc_preposition},
+    {"conj", wc_conjunction},   {"conjunction", wc_conjunction},
+    {"det", wc_determiner},     {"determiner", wc_determiner},
+    {"interj", wc_interjection}, {"interjection", wc_interjection}
+};
+
+constexpr size_t word_class_slots = 64;
+
+constexpr uint32_t wordClassHash(std::string_view s, uint32_t seed)
+{
+    for(char c : s) seed = (seed ^ uint8_t(c)) * 16777619u;
+    return seed;
+}
+
+// first seed for which every alias gets a slot of its own
+constexpr uint32_t findWordClassSeed()
+{
+    for(uint32_t seed = 2166136261u;; ++seed)
     {
-        if(c == classes[i])
+        bool used[word_class_slots] = {};
+        bool perfect = true;
+        for(auto &a : word_class_aliases)
         {
-            return (i % 2 == 0) ? classes[i + 1] : classes[i];
+            size_t slot = wordClassHash(a.name, seed) % word_class_slots;
+            perfect = perfect && !used[slot];
+            used[slot] = true;
         }
+        if(perfect) return seed;
+    }
+}
+
+constexpr uint32_t word_class_seed = findWordClassSeed();
+
+struct WordClassTable
+{
+    int8_t alias[word_class_slots];
+};
+
+constexpr WordClassTable makeWordClassTable()
+{
+    WordClassTable t = {};
+    for(auto &a : t.alias) a = -1;
+    for(size_t i = 0; i < sizeof(word_class_aliases) / sizeof(word_class_aliases[0]); ++i)
+        t.alias[wordClassHash(word_class_aliases[i].name, word_class_seed) % word_class_slots] = int8_t(i);
+    return t;
+}
+
+// slot of every alias, computed by the compiler
+constexpr WordClassTable word_class_table = makeWordClassTable();
+
+// resolves a class spelling with one hash and one compare
+constexpr WordClass getWordClass(std::string_view c)
+{
+    int8_t i = word_class_table.alias[wordClassHash(c, word_class_seed) % word_class_slots];
+    return (i >= 0 && word_class_aliases[i].name == c) ? word_class_aliases[i].cls : wc_unknown;
+}
+
+static_assert(getWordClass("n") == wc_noun && getWordClass("conjunction") == wc_conjunction
+    && getWordClass("vt") == wc_verb && getWordClass("x") == wc_unknown, "word class table is broken");
+
+constexpr const char* wordClassName(WordClass c)
+{
+    return c < word_class_count ? word_class_names[c] : "unknown";
+}
+
+inline std::ostream& operator<<(std::ostream &s, WordClass c)
+{
+    return s << wordClassName(c);
+}
+
+// splits a defi item "(class)definition" into its class and the definition,
+// items without a proper class are of unknown class
+std::pair<WordClass, std::string_view> splitDefinition(std::string_view s)
+{
+    size_t bracket_begin = s.find('('), bracket_end = s.find(')');
+    if(bracket_begin == std::string_view::npos || bracket_end == std::string_view::npos)
+    {
+        // std::cerr << "bracket not properly closed or not found, treat as unknown class." << std::endl;
+        return std::make_pair(wc_unknown, s);
+    }
+    if(bracket_begin > bracket_end)
+    {
+        parseIssue(pi_bad_class);
+        return std::make_pair(wc_unknown, s);
     }
-    return "unknown";
+    return std::make_pair(getWordClass(s.substr(bracket_begin + 1, bracket_end - bracket_begin - 1)), s.substr(bracket_end + 1));
 }
 
 #define HEAD(x) FRONT_CYAN << (x) << FRONT_DEFAULT
@@ -117,47 +524,103 @@ std::string getWordClass(const std::string &c)
 #define DEFI(x) FRONT_WHITE << (x) << FRONT_DEFAULT
 #define CATE(x) FRONT_RED << (x) << FRONT_DEFAULT
 
+// echoes a typed character in color with one write of the prebuilt
+// sequences, instead of three stream insertions per key
+void echoKey(std::ostream &s, const ConsoleColorModifier &color, char c)
+{
+    char buffer[24];
+    std::string_view on = color.sequence(), off = FRONT_DEFAULT.sequence();
+    size_t n = on.size();
+    memcpy(buffer, on.data(), n);
+    buffer[n++] = c;
+    memcpy(buffer + n, off.data(), off.size());
+    s.write(buffer, n + off.size());
+}
+
 struct Word
 {
     std::string                             word; // water, sun, ...
-    std::multimap<std::string, std::string> defi; // <class, def>
+    std::multimap<WordClass, std::string>   defi; // <class, def>
     std::set<std::string>                   coll;
     std::set<std::string>                   exam;
     std::set<std::string>                   cate;
 
-            void            print(std::ostream &s)
+            // appends the record, as print shows it, to out
+            void            render(std::string &out) const
     {
+        auto line = [&out](const ConsoleColorModifier &color, std::string_view text) {
+            out += color.sequence();
+            out += text;
+            out += FRONT_DEFAULT.sequence();
+            out += '\n';
+        };
         // word
-        s << HEAD(word) << "\n";
+        line(FRONT_CYAN, word);
         // defi
         if(defi.empty())
         {
-            s << "<no definitions>\n";
+            out += "<no definitions>\n";
         }
         else
         {
-            s << "[definitions]\n";
+            out += "[definitions]\n";
             for(auto i = defi.begin(); i != defi.end(); ++i)
             {
-                s << CLAS(i->first) << ": " << DEFI(i->second) << '\n';
+                out += FRONT_YELLOW.sequence();
+                out += wordClassName(i->first);
+                out += FRONT_DEFAULT.sequence();
+                out += ": ";
+                line(FRONT_WHITE, i->second);
             }
         }
         // coll
-        if(coll.empty()) s << "<no collocations>\n";
-        else { s << "[collocations]\n"; for(auto &c : coll) s << COLL(c) << "\n"; }
+        if(coll.empty()) out += "<no collocations>\n";
+        else { out += "[collocations]\n"; for(auto &c : coll) line(FRONT_MAGENTA, c); }
         // exam
-        if(exam.empty()) s << "<no examples>\n";
-        else { s << "[examples]\n"; for(auto &e : exam) s << STCE(e) << "\n"; }
+        if(exam.empty()) out += "<no examples>\n";
+        else { out += "[examples]\n"; for(auto &e : exam) line(FRONT_GREEN, e); }
         // cate
-        if(cate.empty()) s << "<uncategorized>\n";
-        else { s << "[categories]\n"; for(auto &c : cate) s << CATE(c) << "\n"; }
+        if(cate.empty()) out += "<uncategorized>\n";
+        else { out += "[categories]\n"; for(auto &c : cate) line(FRONT_RED, c); }
+    }
+
+            // renders into a buffer reused across calls and hands s the
+            // record in one write
+            void            print(std::ostream &s) const
+    {
+        static thread_local std::string buffer;
+        buffer.clear();
+        render(buffer);
+        s.write(buffer.data(), buffer.size());
+    }
+
+            void        addItem(std::string_view title, std::string &&s)
+    {
+        if(title == "defi")
+        {
+            auto d = splitDefinition(s);
+            defi.insert(std::make_pair(d.first, std::string(d.second)));
+        }
+        else if(title == "coll")
+            coll.insert(std::move(s));
+        else if(title == "exam")
+            exam.insert(std::move(s));
+        else if(title == "cate")
+            cate.insert(std::move(s));
+        else
+            parseIssue(pi_unknown_item);
+    }
+
+            void        addItem(std::string_view title, std::string_view s)
+    {
+        addItem(title, std::string(s));
     }
 
             void        merge(Word &w)
     {
         if(w.word != word)
         {
-            std::cerr << "trying to merge different words." << std::endl;
+            parseIssue(pi_different_words);
             return;
         }
         defi.insert(w.defi.begin(), w.defi.end());
@@ -197,7 +660,8 @@ struct Word
             s << ":cate:\n";
             for(auto &c : w.cate) s << c << "$\n";
         }
-        s << "]" << std::endl;
+        s << "]\n";
+        return s;
     }
 
     friend  std::istream&   operator>>(std::istream &stream, Word &w)
@@ -233,7 +697,7 @@ struct Word
                     }
                     // we shouldn't meet any other character
                     state = bad_state;
-                    std::cerr << "expected begin of word block." << std::endl;
+                    parseIssue(pi_expected_block);
                     break;
                 }
                 case seek_word_entity:
@@ -247,7 +711,7 @@ struct Word
                         break;
                     }
                     state = bad_state;
-                    std::cerr << "expected word entity." << std::endl;
+                    parseIssue(pi_expected_entity);
                     break;
                 }
                 case read_word_entity:
@@ -261,13 +725,13 @@ struct Word
                         if(word_stack.empty())
                         {
                             state = bad_state;
-                            std::cerr << "expected word entity." << std::endl;
+                            parseIssue(pi_expected_entity);
                             break;
                         }
                         if(!w.word.empty() && w.word != word_stack.back())
                         {
                             state = bad_state;
-                            std::cerr << "trying to merge different words." << std::endl;
+                            parseIssue(pi_different_words);
                             break;
                         }
                         w.word = std::move(word_stack.back());
@@ -294,7 +758,7 @@ struct Word
                         break;
                     }
                     state = bad_state;
-                    std::cerr << "expected item indicator." << std::endl;
+                    parseIssue(pi_expected_indicator);
                     break;
                 }
                 case begin_item_title:
@@ -308,7 +772,7 @@ struct Word
                         break;
                     }
                     state = bad_state;
-                    std::cerr << "expected item title." << std::endl;
+                    parseIssue(pi_expected_title);
                     break;
                 }
                 case read_item_title:
@@ -329,7 +793,7 @@ struct Word
                         break;
                     }
                     state = bad_state;
-                    std::cerr << "expected item end." << std::endl;
+                    parseIssue(pi_expected_item_end);
                     break;
                 }
                 case seek_item_end:
@@ -341,7 +805,7 @@ struct Word
                         break;
                     }
                     state = bad_state;
-                    std::cerr << "expected item end." << std::endl;
+                    parseIssue(pi_expected_item_end);
                     break;
                 }
                 case seek_item_content:
@@ -350,7 +814,7 @@ struct Word
                     if(c == '$')
                     {
                         state = seek_item_content;
-                        std::cerr << "warning: blank item content." << std::endl;
+                        parseIssue(pi_blank_content);
                         break;
                     }
                     if(c == ':')
@@ -375,40 +839,13 @@ struct Word
                         if(word_stack.empty())
                         {
                             state = bad_state;
-                            std::cerr << "expected item content." << std::endl;
+                            parseIssue(pi_expected_content);
                             break;
                         }
-                        auto s = word_stack.back();
+                        auto s = std::move(word_stack.back());
                         word_stack.pop_back();
                         // std::cerr << "pop item content" << std::endl;
-                        if(word_stack.back() == "defi")
-                        {
-                            size_t bracket_begin = s.find('('), bracket_end = s.find(')');
-                            if(bracket_begin == std::string::npos || bracket_end == std::string::npos)
-                            {
-                                // std::cerr << "bracket not properly closed or not found, treat as unknown class." << std::endl;
-                                w.defi.insert(std::make_pair("unknown", std::move(s)));
-                            }
-                            else
-                            {
-                                if(bracket_begin > bracket_end)
-                                {
-                                    std::cerr << "wrong bracket order, treat as unknown class." << std::endl;
-                                    w.defi.insert(std::make_pair("unknown", std::move(s)));
-                                }
-                                std::string word_class(s.begin() + bracket_begin + 1, s.begin() + bracket_end);
-                                s.erase(s.begin(), s.begin() + bracket_end + 1);
-                                w.defi.insert(std::make_pair(getWordClass(word_class), std::move(s)));
-                            }
-                        }
-                        else if(word_stack.back() == "coll")
-                            w.coll.insert(std::move(s));
-                        else if(word_stack.back() == "exam")
-                            w.exam.insert(std::move(s));
-                        else if(word_stack.back() == "cate")
-                            w.cate.insert(std::move(s));
-                        else
-                            std::cerr << "unrecognized item, ignored." << std::endl;
+                        w.addItem(word_stack.back(), std::move(s));
 
                         state = seek_item_content;
                     }
@@ -416,13 +853,13 @@ struct Word
                     {
                         if(c == ':')
                         {
-                            std::cerr << "warning: item content unexpectedly ended with ':'." << std::endl;
+                            parseIssue(pi_content_ended_colon);
                             state = begin_item_title;
                             break;
                         }
                         if(c == ']')
                         {
-                            std::cerr << "warning: item content unexpectedly ended with ']'." << std::endl;
+                            parseIssue(pi_content_ended_bracket);
                             state = block_ended;
                             break;
                         }
@@ -434,141 +871,6187 @@ struct Word
         }
         if(state == bad_state)
         {
+            stats.count(sc_bad_records);
             std::cerr << "error parsing word record at position " << stream.tellg() << std::endl;
         }
         return stream;
     }
 };
 
-struct termios original_state;
-
-void enableNoncanonicalInput()
+// read-only view over a whole file, mmapped when possible and read in one
+// block otherwise (pipes, empty files, ...)
+class FileView
 {
-    struct termios tattr;
-    tcgetattr(STDIN_FILENO, &tattr);
-    tattr.c_lflag &= ~(ICANON|ECHO); /* Clear ICANON and ECHO. */
-    tattr.c_cc[VMIN] = 1;
-    tattr.c_cc[VTIME] = 0;
-    tcsetattr(STDIN_FILENO, TCSAFLUSH, &tattr);  
-}
+    const char     *mData = nullptr;
+    size_t          mSize = 0;
+    bool            mMapped = false;
+    std::string     mBuffer;
 
-void disableNoncanonicalInput()
-{
-    tcsetattr(STDIN_FILENO, TCSANOW, &original_state);
-}
+public:
+    explicit FileView(const char *path, bool sequential = true)
+    {
+        int fd = open(path, O_RDONLY);
+        if(fd < 0) return;
+        struct stat st;
+        if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED)
+            {
+                madvise(p, st.st_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+                mData = static_cast<const char*>(p);
+                mSize = st.st_size;
+                mMapped = true;
+            }
+        }
+        if(!mMapped)
+        {
+            char block[1 << 16];
+            ssize_t n;
+            while((n = read(fd, block, sizeof(block))) > 0) mBuffer.append(block, n);
+            mData = mBuffer.data();
+            mSize = mBuffer.size();
+        }
+        ::close(fd);
+    }
+    ~FileView()
+    {
+        if(mMapped) munmap(const_cast<char*>(mData), mSize);
+    }
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
 
-void signalHandler(int /* signum */)
-{
-    std::cerr << "Received signal SIGINT, type '|' to exit, '~' to reset state." << std::endl;
-}
+    std::string_view view() const { return std::string_view(mData, mSize); }
+};
 
-int main()
+// output stream buffer writing to a file descriptor in large blocks
+class FdBuffer : public std::streambuf
 {
-    signal(SIGINT, signalHandler);
+    int                 mFd;
+    std::vector<char>   mBuffer;
+    uint64_t            mWriteTime = 0;
 
-    std::map<std::string, Word> word_map;
-    std::fstream file;
+protected:
+    int_type        overflow(int_type c) override
+    {
+        if(sync() != 0) return traits_type::eof();
+        if(c != traits_type::eof())
+        {
+            *pptr() = c;
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
 
-    file.open("dict", std::ios_base::in);
-    Word wcache;
-    while(file >> wcache)
+    int             sync() override
     {
-        auto &w = word_map[wcache.word];
-        w.word = wcache.word;
-        w.merge(wcache);
-        wcache = Word();
+        Stopwatch watch;
+        for(char *p = pbase(); p < pptr();)
+        {
+            ssize_t n = ::write(mFd, p, pptr() - p);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) return -1;
+            p += n;
+        }
+        setp(mBuffer.data(), mBuffer.data() + mBuffer.size());
+        mWriteTime += watch.lap();
+        return 0;
     }
-    file.close();
-    
-    if(!isatty(STDIN_FILENO))
+
+public:
+    explicit FdBuffer(int fd, size_t size = 1 << 20) : mFd(fd), mBuffer(size)
     {
-        std::cerr << "STDIN_FILENO is not a terminal." << std::endl;
+        setp(mBuffer.data(), mBuffer.data() + mBuffer.size());
     }
-    tcgetattr(STDIN_FILENO, &original_state); // get current state;
-    enableNoncanonicalInput();
-    atexit(disableNoncanonicalInput);
+    ~FdBuffer() { sync(); }
 
-    char c;
-    enum input_parse_state
+    // nanoseconds spent in write()
+    uint64_t        writeTime() const { return mWriteTime; }
+};
+
+enum parse_result
+{
+    parse_ok,       // block ended with ']'
+    parse_error,    // malformed block, w holds what was read before the error
+    parse_end       // no more complete blocks
+};
+
+// same grammar and diagnostics as Word::operator>>, but runs over an in-memory
+// buffer starting at pos. tokens are kept as slices of the buffer and copied
+// exactly once, into w. pos is advanced past the consumed characters.
+// Record is Word or any type with a string-like `word` and an
+// addItem(std::string_view title, std::string_view content).
+template<class Record>
+parse_result parseWord(std::string_view buf, size_t &pos, Record &w)
+{
+    enum buffer_read_state
     {
-        wait_input,
-        read_lookup_word,
-        read_remove_word,
-        add_content,
+        seek_word_block,
+        seek_word_entity,
+        read_word_entity,
+        seek_item,
+        begin_item_title,
+        read_item_title,
+        seek_item_end,
+        seek_item_content,
+        read_item_content,
+        block_ended,
         bad_state
     };
-    std::deque<std::pair<input_parse_state, std::vector<std::string>>> state_stack;
-    state_stack.emplace_back(std::make_pair(wait_input, std::vector<std::string>()));
-    while((c = getchar()) != '|' && c != EOF)
+    buffer_read_state state = seek_word_block;
+    std::string_view title;
+    size_t begin = 0, i = pos;
+    // content may span lines, newlines are dropped like operator>> does
+    std::string joined;
+    auto content = [&](size_t end) {
+        std::string_view sv = buf.substr(begin, end - begin);
+        if(sv.find('\n') == std::string_view::npos) return sv;
+        joined.clear();
+        for(char c : sv) if(c != '\n') joined.push_back(c);
+        return std::string_view(joined);
+    };
+    for(; state != bad_state && state != block_ended && i < buf.size(); ++i)
     {
-    begin_loop:
-        if(state_stack.empty())
+        char c = buf[i];
+        switch(state)
         {
-            std::cerr << "empty state stack." << std::endl;
-            continue;
-        }
-        if(c == '~' && state_stack.back().first != wait_input)
-        {
-            std::cerr << "reseting state." << std::endl;
-            state_stack.pop_back();
-            continue;
-        }
-        switch(state_stack.back().first)
-        {
-            case wait_input:
+            case seek_word_block:
             {
-                if(isalpha(c))
+                if(isspace(c)) break;
+                if(c == '[')
                 {
-                    state_stack.emplace_back(std::make_pair(read_lookup_word, std::vector<std::string>()));
-                    std::cerr << "lookup: ";
-                    goto begin_loop; // let other section handle this char
+                    state = seek_word_entity;
+                    break;
                 }
-                if(c == '+')
+                state = bad_state;
+                parseIssue(pi_expected_block, i);
+                break;
+            }
+            case seek_word_entity:
+            {
+                if(isspace(c)) break;
+                if(isalpha(c))
                 {
-                    state_stack.emplace_back(std::make_pair(add_content, std::vector<std::string>()));
-                    std::cerr << "add: ";
+                    state = read_word_entity;
+                    begin = i;
                     break;
                 }
-                if(c == '-')
+                state = bad_state;
+                parseIssue(pi_expected_entity, i);
+                break;
+            }
+            case read_word_entity:
+            {
+                if(isalpha(c)) break;
+                std::string_view entity = buf.substr(begin, i - begin);
+                if(!w.word.empty() && w.word != entity)
                 {
-                    state_stack.emplace_back(std::make_pair(read_remove_word, std::vector<std::string>()));
-                    std::cerr << "remove: ";
+                    state = bad_state;
+                    parseIssue(pi_different_words, i);
                     break;
                 }
+                w.word = entity;
+                if(c == ':') state = begin_item_title;
+                else if(c == ']') state = block_ended;
+                else state = seek_item;
                 break;
             }
-            case read_lookup_word:
+            case seek_item:
             {
-                // make sure we have space to store chars
-                if(state_stack.back().second.empty()) state_stack.back().second.emplace_back();
-                auto &wdstr = state_stack.back().second[0];
-                if(c == '\n')
+                if(isspace(c)) break;
+                if(c == ':')
                 {
-                    putchar('\n');
-                    if(!wdstr.empty())
-                    {
-                        auto i = word_map.find(wdstr);
-                        if(i == word_map.end())
-                        {
-                            std::cerr << "word '" << HEAD(wdstr) << "' not found." << std::endl;
-                            auto lb = word_map.lower_bound(wdstr);
-                            size_t count = 0;
-                            for(; lb != word_map.end() && lb->first.find(wdstr) == 0; ++lb, ++count)
-                            {
-                                std::cerr << "are you finding '" << HEAD(lb->first) << "'?" << std::endl;
-                            }
-                            if(count == 1)
-                            {
-                                std::cerr << "selecting '" << HEAD((--lb)->first) << "'." << std::endl;
-                                lb->second.print(std::cout);
-                            }
-                        }
-                        else
-                        {
-                            i->second.print(std::cout);
-                        }
-                    }
-                    state_stack.pop_back();
+                    state = begin_item_title;
+                    break;
+                }
+                if(c == ']')
+                {
+                    state = block_ended;
+                    break;
+                }
+                state = bad_state;
+                parseIssue(pi_expected_indicator, i);
+                break;
+            }
+            case begin_item_title:
+            {
+                if(isspace(c)) break;
+                if(isalpha(c))
+                {
+                    state = read_item_title;
+                    begin = i;
+                    break;
+                }
+                state = bad_state;
+                parseIssue(pi_expected_title, i);
+                break;
+            }
+            case read_item_title:
+            {
+                if(isalpha(c)) break;
+                title = buf.substr(begin, i - begin);
+                if(isspace(c))
+                {
+                    state = seek_item_end;
+                    break;
+                }
+                if(c == ':')
+                {
+                    state = seek_item_content;
+                    break;
+                }
+                state = bad_state;
+                parseIssue(pi_expected_item_end, i);
+                break;
+            }
+            case seek_item_end:
+            {
+                if(isspace(c)) break;
+                if(c == ':')
+                {
+                    state = seek_item_content;
+                    break;
+                }
+                state = bad_state;
+                parseIssue(pi_expected_item_end, i);
+                break;
+            }
+            case seek_item_content:
+            {
+                if(isspace(c)) break;
+                if(c == '$')
+                {
+                    parseIssue(pi_blank_content, i);
+                    break;
+                }
+                if(c == ':')
+                {
+                    state = begin_item_title;
+                    break;
+                }
+                if(c == ']')
+                {
+                    state = block_ended;
+                    break;
+                }
+                state = read_item_content;
+                begin = i;
+                break;
+            }
+            case read_item_content:
+            {
+                // jump straight to the next character that can end the item:
+                // memchr for each of them, a window at a time, every find
+                // narrowing the window for the next one
+                size_t end = buf.size();
+                for(size_t from = i; from < buf.size() && end == buf.size(); from += 4096)
+                {
+                    std::string_view window = buf.substr(from, 4096);
+                    for(char stop : {'$', ':', ']'})
+                    {
+                        auto p = static_cast<const char*>(memchr(window.data(), stop, window.size()));
+                        if(p == nullptr) continue;
+                        window = window.substr(0, p - window.data());
+                        end = p - buf.data();
+                    }
+                }
+                if(end == buf.size())
+                {
+                    i = buf.size() - 1;
+                    break;
+                }
+                i = end;
+                c = buf[i];
+                if(c == '$')
+                {
+                    w.addItem(title, content(i));
+                    state = seek_item_content;
+                }
+                else if(c == ':')
+                {
+                    parseIssue(pi_content_ended_colon, i);
+                    state = begin_item_title;
+                }
+                else
+                {
+                    parseIssue(pi_content_ended_bracket, i);
+                    state = block_ended;
+                }
+                break;
+            }
+            default: break;
+        }
+    }
+    pos = i;
+    if(state == bad_state)
+    {
+        stats.count(sc_bad_records);
+        if(!parse_listener) std::cerr << "error parsing word record at position " << pos << std::endl;
+        return parse_error;
+    }
+    return state == block_ended ? parse_ok : parse_end;
+}
+
+// moves w into word_map, merging it into the entry of the same head word if any
+void storeWord(std::map<std::string, Word> &word_map, Word &&w)
+{
+    // dict is written in order, so appending is the common case
+    if(word_map.empty() || word_map.rbegin()->first < w.word)
+    {
+        word_map.emplace_hint(word_map.end(), w.word, std::move(w));
+        return;
+    }
+    auto i = word_map.find(w.word);
+    if(i == word_map.end()) word_map.emplace(w.word, std::move(w));
+    else
+    {
+        i->second.merge(w);
+        stats.count(sc_merges);
+    }
+}
+
+// parses every block of buf from pos on into word_map.
+// returns the number of records read.
+size_t parseWords(std::string_view buf, size_t pos, std::map<std::string, Word> &word_map)
+{
+    size_t count = 0;
+    Word wcache;
+    while(parseWord(buf, pos, wcache) != parse_end)
+    {
+        ++count;
+        if(!wcache.word.empty()) storeWord(word_map, std::move(wcache));
+        wcache = Word();
+    }
+    return count;
+}
+
+// parses a whole dictionary text into word_map, merging duplicated head
+// words. with jobs > 1 the text is cut into chunks parsed on that many
+// threads. returns the number of records read.
+size_t parseDictionary(std::string_view buf, std::map<std::string, Word> &word_map, unsigned jobs = 1)
+{
+    if(jobs <= 1 || buf.size() < (1 << 20)) return parseWords(buf, 0, word_map);
+
+    // a ']' ends the current block in every parser state (or fails it), so
+    // parseWord always restarts right after one: cutting the buffer there
+    // yields exactly the records of a serial load.
+    size_t chunks = jobs * 4;
+    std::vector<size_t> bounds{0};
+    for(size_t k = 1; k < chunks; ++k)
+    {
+        size_t p = buf.find(']', std::max(bounds.back(), buf.size() / chunks * k));
+        if(p == std::string_view::npos) break;
+        if(p + 1 > bounds.back()) bounds.push_back(p + 1);
+    }
+    if(bounds.back() != buf.size()) bounds.push_back(buf.size());
+
+    std::vector<std::map<std::string, Word>> parts(bounds.size() - 1);
+    std::vector<size_t> counts(parts.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+    for(size_t t = 0; t < std::min<size_t>(jobs, parts.size()); ++t)
+    {
+        pool.emplace_back([&] {
+            // positions in diagnostics stay relative to the whole file
+            for(size_t k; (k = next++) < parts.size();)
+                counts[k] = parseWords(buf.substr(0, bounds[k + 1]), bounds[k], parts[k]);
+        });
+    }
+    for(auto &t : pool) t.join();
+
+    // chunks are in file order, so for a sorted dict the nodes just get
+    // relinked to the end of word_map; only duplicates go through merge().
+    size_t count = 0;
+    for(size_t k = 0; k < parts.size(); ++k)
+    {
+        count += counts[k];
+        auto &part = parts[k];
+        while(!part.empty())
+        {
+            auto node = part.extract(part.begin());
+            if(word_map.empty() || word_map.rbegin()->first < node.key())
+            {
+                word_map.insert(word_map.end(), std::move(node));
+                continue;
+            }
+            auto i = word_map.find(node.key());
+            if(i == word_map.end()) word_map.insert(std::move(node));
+            else
+            {
+                i->second.merge(node.mapped());
+                stats.count(sc_merges);
+            }
+        }
+    }
+    return count;
+}
+
+// loads a dictionary file into word_map like parseDictionary does, timing
+// the reading and the parsing apart
+size_t loadDictionary(const char *path, std::map<std::string, Word> &word_map, unsigned jobs = 1)
+{
+    Stopwatch watch;
+    uint64_t faults = majorFaults();
+    FileView file(path);
+    stats.time(st_load_io, watch.lap());
+    size_t count = parseDictionary(file.view(), word_map, jobs);
+    // pages of a mapped dict are read as the parser touches them
+    stats.time(st_load_parse, watch.lap());
+    stats.count(sc_load_faults, majorFaults() - faults);
+    stats.count(sc_records, count);
+    return count;
+}
+
+// binary snapshot of a dictionary, meant to be mmapped and queried in place.
+// all integers are native-endian. layout:
+//   SnapshotHeader
+//   SnapshotWord  index[words + 1]     sorted by head word, last one is a sentinel
+//   SnapshotDefi  defi[...]            word i owns [index[i].defi, index[i + 1].defi)
+//   SnapshotText  coll[...], exam[...], cate[...]  same scheme
+//   char          strings[...]         string table, category names are shared
+struct SnapshotText
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct SnapshotDefi
+{
+    SnapshotText text;
+    WordClass    cls;
+    uint8_t      reserved[3];
+};
+
+struct SnapshotWord
+{
+    SnapshotText word;
+    uint32_t     defi, coll, exam, cate;
+};
+
+struct SnapshotHeader
+{
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    words;
+    uint64_t    index, defi, coll, exam, cate, strings;
+    uint64_t    strings_size;
+};
+
+static const char       snapshot_magic[8] = {'V', 'O', 'C', 'S', 'N', 'A', 'P', '\0'};
+static const uint32_t   snapshot_version = 2;
+
+// read-only, sorted collection of words a Dictionary can be layered on
+class WordSource
+{
+public:
+    virtual ~WordSource() {}
+
+    virtual size_t              size() const = 0;
+    virtual std::string_view    word(size_t i) const = 0;
+    // builds the full record of the i-th word
+    virtual Word                get(size_t i) const = 0;
+    // writes the i-th word in dict format
+    virtual void                writeWord(size_t i, std::ostream &s) const { s << get(i); }
+
+    // index of the first head word not less than w
+    size_t                      lowerBound(std::string_view w) const
+    {
+        size_t lo = 0, hi = size();
+        while(lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if(word(mid) < w) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // index of w, or size() if it is not in the source
+    size_t                      find(std::string_view w) const
+    {
+        size_t i = lowerBound(w);
+        return (i < size() && word(i) == w) ? i : size();
+    }
+};
+
+// words in the snapshot layout: a sorted index whose entries own ranges of
+// shared item arrays, all text in one string table
+class FlatLayout : public WordSource
+{
+protected:
+    size_t                  mWords = 0;
+    const SnapshotWord     *mIndex = nullptr;
+    const SnapshotDefi     *mDefi = nullptr;
+    const SnapshotText     *mColl = nullptr, *mExam = nullptr, *mCate = nullptr;
+    const char             *mStrings = nullptr;
+
+public:
+    size_t              size() const override { return mWords; }
+    std::string_view    text(const SnapshotText &t) const { return std::string_view(mStrings + t.offset, t.size); }
+    std::string_view    word(size_t i) const override { return text(mIndex[i].word); }
+
+    Word                get(size_t i) const override
+    {
+        const SnapshotWord &b = mIndex[i], &e = mIndex[i + 1];
+        Word w;
+        w.word = word(i);
+        for(auto d = mDefi + b.defi; d != mDefi + e.defi; ++d)
+            w.defi.emplace(d->cls, text(d->text));
+        for(auto t = mColl + b.coll; t != mColl + e.coll; ++t) w.coll.emplace(text(*t));
+        for(auto t = mExam + b.exam; t != mExam + e.exam; ++t) w.exam.emplace(text(*t));
+        for(auto t = mCate + b.cate; t != mCate + e.cate; ++t) w.cate.emplace(text(*t));
+        return w;
+    }
+
+    // same text as operator<< on get(i), without building the Word
+    void                writeWord(size_t i, std::ostream &s) const override
+    {
+        const SnapshotWord &b = mIndex[i], &e = mIndex[i + 1];
+        s << "[\n" << word(i) << "\n";
+        if(b.defi != e.defi)
+        {
+            s << ":defi:\n";
+            for(auto d = mDefi + b.defi; d != mDefi + e.defi; ++d) s << "(" << d->cls << ")" << text(d->text) << "$\n";
+        }
+        auto items = [&](const char *title, const SnapshotText *begin, const SnapshotText *end) {
+            if(begin == end) return;
+            s << title;
+            for(auto t = begin; t != end; ++t) s << text(*t) << "$\n";
+        };
+        items(":coll:\n", mColl + b.coll, mColl + e.coll);
+        items(":exam:\n", mExam + b.exam, mExam + e.exam);
+        items(":cate:\n", mCate + b.cate, mCate + e.cate);
+        s << "]\n";
+    }
+};
+
+class Snapshot : public FlatLayout
+{
+    FileView                mFile;
+
+    // true if every item range of the index lies in its section and every
+    // string in the string table, so reading the snapshot stays in bounds
+    bool                valid(const SnapshotHeader &h) const
+    {
+        auto inside = [&](const SnapshotText &t) { return uint64_t(t.offset) + t.size <= h.strings_size; };
+        for(size_t i = 0; i < mWords; ++i)
+        {
+            const SnapshotWord &b = mIndex[i], &e = mIndex[i + 1];
+            if(!inside(b.word) || b.defi > e.defi || b.coll > e.coll || b.exam > e.exam || b.cate > e.cate) return false;
+        }
+        const SnapshotWord &first = mIndex[0], &last = mIndex[mWords];
+        if(last.defi > (h.coll - h.defi) / sizeof(SnapshotDefi) || last.coll > (h.exam - h.coll) / sizeof(SnapshotText)
+            || last.exam > (h.cate - h.exam) / sizeof(SnapshotText) || last.cate > (h.strings - h.cate) / sizeof(SnapshotText)) return false;
+        for(auto d = mDefi + first.defi; d != mDefi + last.defi; ++d)
+        {
+            if(!inside(d->text) || d->cls >= word_class_count) return false;
+        }
+        auto texts = [&](const SnapshotText *begin, const SnapshotText *end) {
+            return std::all_of(begin, end, inside);
+        };
+        return texts(mColl + first.coll, mColl + last.coll) && texts(mExam + first.exam, mExam + last.exam)
+            && texts(mCate + first.cate, mCate + last.cate);
+    }
+
+public:
+    explicit Snapshot(const char *path) : mFile(path, false)
+    {
+        std::string_view buf = mFile.view();
+        if(buf.size() < sizeof(SnapshotHeader)) return;
+        auto h = reinterpret_cast<const SnapshotHeader*>(buf.data());
+        if(memcmp(h->magic, snapshot_magic, sizeof(snapshot_magic)) != 0 || h->version != snapshot_version)
+        {
+            std::cerr << "not a snapshot or unsupported snapshot version." << std::endl;
+            return;
+        }
+        if(h->strings > buf.size() || h->strings_size > buf.size() - h->strings || h->index >= h->defi
+            || h->defi > h->coll || h->coll > h->exam || h->exam > h->cate || h->cate > h->strings
+            || (h->defi - h->index) / sizeof(SnapshotWord) < uint64_t(h->words) + 1
+            || (h->index | h->defi | h->coll | h->exam | h->cate) % alignof(SnapshotWord) != 0)
+        {
+            std::cerr << "snapshot is truncated or corrupted." << std::endl;
+            return;
+        }
+        mIndex = reinterpret_cast<const SnapshotWord*>(buf.data() + h->index);
+        mDefi = reinterpret_cast<const SnapshotDefi*>(buf.data() + h->defi);
+        mColl = reinterpret_cast<const SnapshotText*>(buf.data() + h->coll);
+        mExam = reinterpret_cast<const SnapshotText*>(buf.data() + h->exam);
+        mCate = reinterpret_cast<const SnapshotText*>(buf.data() + h->cate);
+        mStrings = buf.data() + h->strings;
+        mWords = h->words;
+        if(!valid(*h))
+        {
+            std::cerr << "snapshot is truncated or corrupted." << std::endl;
+            mIndex = nullptr;
+            mWords = 0;
+        }
+    }
+
+    bool                good() const { return mIndex != nullptr; }
+};
+
+// bump allocator handing out memory from large blocks that are only
+// released all at once, with the arena
+class WordArena
+{
+    std::vector<std::unique_ptr<char[]>>    mBlocks;
+    size_t                                  mUsed = 0, mCapacity = 0, mTotal = 0;
+
+    static constexpr size_t block_size = 1 << 20;
+
+public:
+    void*               allocate(size_t size, size_t align)
+    {
+        size_t offset = (mUsed + align - 1) & ~(align - 1);
+        if(mBlocks.empty() || offset + size > mCapacity)
+        {
+            mCapacity = std::max(block_size, size);
+            mBlocks.emplace_back(new char[mCapacity]);
+            mTotal += mCapacity;
+            offset = 0;
+        }
+        mUsed = offset + size;
+        return mBlocks.back().get() + offset;
+    }
+
+    std::string_view    copy(std::string_view s)
+    {
+        if(s.empty()) return std::string_view();
+        char *p = static_cast<char*>(allocate(s.size(), 1));
+        memcpy(p, s.data(), s.size());
+        return std::string_view(p, s.size());
+    }
+
+    template<class T>
+    const T*            copy(const std::vector<T> &v)
+    {
+        if(v.empty()) return nullptr;
+        T *p = static_cast<T*>(allocate(v.size() * sizeof(T), alignof(T)));
+        std::copy(v.begin(), v.end(), p);
+        return p;
+    }
+
+    size_t              bytes() const { return mTotal; }
+};
+
+// stores each distinct string once and hands out small ids for it
+class StringPool
+{
+    WordArena                                       &mArena;
+    std::unordered_map<std::string_view, uint32_t>  mIds;
+    std::vector<std::string_view>                   mStrings;
+
+public:
+    explicit StringPool(WordArena &arena) : mArena(arena) {}
+
+    uint32_t            intern(std::string_view s)
+    {
+        auto i = mIds.find(s);
+        if(i != mIds.end()) return i->second;
+        mStrings.push_back(mArena.copy(s));
+        return mIds.emplace(mStrings.back(), uint32_t(mStrings.size() - 1)).first->second;
+    }
+
+    // id of s, or size() if it was never interned
+    uint32_t            find(std::string_view s) const
+    {
+        auto i = mIds.find(s);
+        return i != mIds.end() ? i->second : uint32_t(mStrings.size());
+    }
+
+    std::string_view    get(uint32_t id) const { return mStrings[id]; }
+    size_t              size() const { return mStrings.size(); }
+};
+
+// words loaded from text into a per-dictionary arena: head words and item
+// texts are copied into it, category names are interned, and each
+// word keeps its items in arrays also allocated from the arena. loading
+// performs a handful of block allocations instead of several per item.
+class ArenaStore : public WordSource
+{
+    struct PackedDefi
+    {
+        WordClass           cls;
+        std::string_view    text;
+    };
+
+    struct PackedWord
+    {
+        std::string_view        word;
+        const PackedDefi       *defi;
+        const std::string_view *coll, *exam;
+        const uint32_t         *cate;
+        uint32_t                defi_count, coll_count, exam_count, cate_count;
+    };
+
+    WordArena                       mArena;
+    StringPool                      mCategories;
+    std::vector<PackedWord>         mWords;
+    // items of the record being parsed, reused between records
+    std::vector<PackedDefi>         mDefi;
+    std::vector<std::string_view>   mColl, mExam;
+    std::vector<uint32_t>           mCate;
+
+    // what parseWord fills, items go straight to the staging vectors
+    struct Record
+    {
+        ArenaStore         &store;
+        std::string_view    word;
+
+        void addItem(std::string_view title, std::string_view s) { store.addItem(title, s); }
+    };
+
+    void                addItem(std::string_view title, std::string_view s)
+    {
+        if(title == "defi")
+        {
+            auto d = splitDefinition(s);
+            mDefi.push_back({d.first, mArena.copy(d.second)});
+        }
+        else if(title == "coll")
+            mColl.push_back(mArena.copy(s));
+        else if(title == "exam")
+            mExam.push_back(mArena.copy(s));
+        else if(title == "cate")
+            mCate.push_back(mCategories.intern(s));
+        else
+            parseIssue(pi_unknown_item);
+    }
+
+    // keeps the ordering and uniqueness Word gets from its containers: the
+    // multimap of definitions orders by class, stable for equal ones
+    void                normalize()
+    {
+        std::stable_sort(mDefi.begin(), mDefi.end(), [](const PackedDefi &a, const PackedDefi &b) { return a.cls < b.cls; });
+        for(auto v : {&mColl, &mExam})
+        {
+            std::sort(v->begin(), v->end());
+            v->erase(std::unique(v->begin(), v->end()), v->end());
+        }
+        std::sort(mCate.begin(), mCate.end(), [&](uint32_t a, uint32_t b) { return mCategories.get(a) < mCategories.get(b); });
+        mCate.erase(std::unique(mCate.begin(), mCate.end()), mCate.end());
+    }
+
+    void                commit(std::string_view word)
+    {
+        normalize();
+        mWords.push_back({mArena.copy(word), mArena.copy(mDefi), mArena.copy(mColl), mArena.copy(mExam), mArena.copy(mCate),
+            uint32_t(mDefi.size()), uint32_t(mColl.size()), uint32_t(mExam.size()), uint32_t(mCate.size())});
+    }
+
+    void                stage(const PackedWord &w)
+    {
+        mDefi.insert(mDefi.end(), w.defi, w.defi + w.defi_count);
+        mColl.insert(mColl.end(), w.coll, w.coll + w.coll_count);
+        mExam.insert(mExam.end(), w.exam, w.exam + w.exam_count);
+        mCate.insert(mCate.end(), w.cate, w.cate + w.cate_count);
+    }
+
+    void                clearStage()
+    {
+        mDefi.clear();
+        mColl.clear();
+        mExam.clear();
+        mCate.clear();
+    }
+
+    // sorts the words and folds duplicated head words like Word::merge does
+    void                finish()
+    {
+        if(std::is_sorted(mWords.begin(), mWords.end(), [](const PackedWord &a, const PackedWord &b) { return a.word <= b.word; }))
+            return;
+        std::stable_sort(mWords.begin(), mWords.end(), [](const PackedWord &a, const PackedWord &b) { return a.word < b.word; });
+        std::vector<PackedWord> words;
+        words.reserve(mWords.size());
+        for(size_t i = 0, j; i < mWords.size(); i = j)
+        {
+            for(j = i + 1; j < mWords.size() && mWords[j].word == mWords[i].word; ++j);
+            if(j == i + 1)
+            {
+                words.push_back(mWords[i]);
+                continue;
+            }
+            clearStage();
+            for(size_t k = i; k < j; ++k) stage(mWords[k]);
+            commit(mWords[i].word);
+            stats.count(sc_merges, j - i - 1);
+            words.push_back(mWords.back());
+            mWords.pop_back();
+        }
+        clearStage();
+        mWords.swap(words);
+    }
+
+public:
+    ArenaStore() : mCategories(mArena) {}
+
+    // parses a whole dictionary text, returns the number of records read
+    size_t              load(std::string_view buf)
+    {
+        Record r{*this, std::string_view()};
+        size_t pos = 0, count = 0;
+        while(parseWord(buf, pos, r) != parse_end)
+        {
+            ++count;
+            if(!r.word.empty()) commit(r.word);
+            clearStage();
+            r.word = std::string_view();
+        }
+        clearStage();
+        finish();
+        return count;
+    }
+
+    size_t              size() const override { return mWords.size(); }
+    std::string_view    word(size_t i) const override { return mWords[i].word; }
+
+    Word                get(size_t i) const override
+    {
+        const PackedWord &p = mWords[i];
+        Word w;
+        w.word = p.word;
+        for(uint32_t k = 0; k < p.defi_count; ++k) w.defi.emplace(p.defi[k].cls, p.defi[k].text);
+        w.coll.insert(p.coll, p.coll + p.coll_count);
+        w.exam.insert(p.exam, p.exam + p.exam_count);
+        for(uint32_t k = 0; k < p.cate_count; ++k) w.cate.emplace(mCategories.get(p.cate[k]));
+        return w;
+    }
+
+    size_t              bytes() const { return mArena.bytes() + mWords.capacity() * sizeof(PackedWord); }
+
+    // what the same words take as std::map<std::string, Word>, modelled on
+    // glibc malloc chunks and red-black tree nodes
+    size_t              nodeBytes() const
+    {
+        auto chunk = [](size_t n) { return std::max<size_t>(32, (n + 8 + 15) & ~size_t(15)); };
+        auto text = [&](std::string_view s) { return s.size() > 15 ? chunk(s.size() + 1) : 0; };
+        const size_t node = 32;
+        size_t total = 0;
+        for(auto &p : mWords)
+        {
+            total += chunk(node + sizeof(std::pair<const std::string, Word>)) + 2 * text(p.word);
+            for(uint32_t k = 0; k < p.defi_count; ++k)
+                total += chunk(node + 2 * sizeof(std::string)) + text(wordClassName(p.defi[k].cls)) + text(p.defi[k].text);
+            for(uint32_t k = 0; k < p.coll_count; ++k) total += chunk(node + sizeof(std::string)) + text(p.coll[k]);
+            for(uint32_t k = 0; k < p.exam_count; ++k) total += chunk(node + sizeof(std::string)) + text(p.exam[k]);
+            for(uint32_t k = 0; k < p.cate_count; ++k) total += chunk(node + sizeof(std::string)) + text(mCategories.get(p.cate[k]));
+        }
+        return total;
+    }
+
+    void                report(std::ostream &s) const
+    {
+        size_t arena = bytes(), nodes = nodeBytes();
+        s << "arena storage: " << size() << " words, " << mCategories.size()
+          << " categories in " << arena << " bytes; as nodes about " << nodes << " bytes, "
+          << (nodes > arena ? nodes - arena : 0) << " saved." << std::endl;
+    }
+};
+
+// words in the snapshot layout, held in memory: head words sorted in one
+// contiguous index, items as ranges of shared vectors and all text in one
+// buffer. built straight from dict text, or from a Dictionary to write a
+// snapshot file.
+class FlatStore : public FlatLayout
+{
+    std::vector<SnapshotWord>                       mIndexData;
+    std::vector<SnapshotDefi>                       mDefiData;
+    std::vector<SnapshotText>                       mCollData, mExamData, mCateData;
+    std::string                                     mStringData;
+    std::unordered_map<std::string, SnapshotText>   mShared;    // category names
+    SnapshotWord                                    mOpen = {};  // where the current record's items begin
+    bool                                            mOverflow = false;
+
+    // what parseWord fills, items go straight to the shared vectors
+    struct Record
+    {
+        FlatStore          &store;
+        std::string_view    word;
+
+        void addItem(std::string_view title, std::string_view s) { store.addItem(title, s); }
+    };
+
+    SnapshotText        add(std::string_view s)
+    {
+        if(mStringData.size() + s.size() > UINT32_MAX) mOverflow = true;
+        SnapshotText t{uint32_t(mStringData.size()), uint32_t(s.size())};
+        mStringData.append(s);
+        return t;
+    }
+
+    SnapshotText        intern(std::string_view s)
+    {
+        auto i = mShared.find(std::string(s));
+        return i != mShared.end() ? i->second : mShared.emplace(s, add(s)).first->second;
+    }
+
+    std::string_view    stored(const SnapshotText &t) const { return std::string_view(mStringData.data() + t.offset, t.size); }
+
+    void                addItem(std::string_view title, std::string_view s)
+    {
+        if(title == "defi")
+        {
+            auto d = splitDefinition(s);
+            mDefiData.push_back({add(d.second), d.first, {}});
+        }
+        else if(title == "coll")
+            mCollData.push_back(add(s));
+        else if(title == "exam")
+            mExamData.push_back(add(s));
+        else if(title == "cate")
+            mCateData.push_back(intern(s));
+        else
+            parseIssue(pi_unknown_item);
+    }
+
+    void                open()
+    {
+        mOpen = {{0, 0}, uint32_t(mDefiData.size()), uint32_t(mCollData.size()), uint32_t(mExamData.size()), uint32_t(mCateData.size())};
+    }
+
+    void                discard()
+    {
+        mDefiData.resize(mOpen.defi);
+        mCollData.resize(mOpen.coll);
+        mExamData.resize(mOpen.exam);
+        mCateData.resize(mOpen.cate);
+    }
+
+    // gives the open record the ordering and uniqueness Word gets from its
+    // containers: definitions stable by class, other items as a set
+    void                normalize()
+    {
+        auto by_text = [&](const SnapshotText &a, const SnapshotText &b) { return stored(a) < stored(b); };
+        auto same_text = [&](const SnapshotText &a, const SnapshotText &b) { return stored(a) == stored(b); };
+        std::stable_sort(mDefiData.begin() + mOpen.defi, mDefiData.end(), [](const SnapshotDefi &a, const SnapshotDefi &b) {
+            return a.cls < b.cls;
+        });
+        std::pair<std::vector<SnapshotText>*, uint32_t> items[] = {{&mCollData, mOpen.coll}, {&mExamData, mOpen.exam}, {&mCateData, mOpen.cate}};
+        for(auto &i : items)
+        {
+            std::sort(i.first->begin() + i.second, i.first->end(), by_text);
+            i.first->erase(std::unique(i.first->begin() + i.second, i.first->end(), same_text), i.first->end());
+        }
+    }
+
+    void                commit(std::string_view word)
+    {
+        normalize();
+        SnapshotWord w = mOpen;
+        w.word = add(word);
+        mIndexData.push_back(w);
+    }
+
+    // sorts the words and folds duplicated head words like Word::merge does
+    void                finish()
+    {
+        auto less = [&](const SnapshotWord &a, const SnapshotWord &b) { return stored(a.word) < stored(b.word); };
+        if(std::adjacent_find(mIndexData.begin(), mIndexData.end(), [&](const SnapshotWord &a, const SnapshotWord &b) {
+            return !less(a, b);
+        }) == mIndexData.end()) return;
+
+        // record k owns items up to where record k + 1 begins
+        std::vector<SnapshotWord> records = std::move(mIndexData);
+        records.push_back({{0, 0}, uint32_t(mDefiData.size()), uint32_t(mCollData.size()), uint32_t(mExamData.size()), uint32_t(mCateData.size())});
+        std::vector<size_t> order(records.size() - 1);
+        for(size_t k = 0; k < order.size(); ++k) order[k] = k;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return less(records[a], records[b]); });
+
+        auto defi = std::move(mDefiData);
+        auto coll = std::move(mCollData), exam = std::move(mExamData), cate = std::move(mCateData);
+        mIndexData.clear();
+        mDefiData.clear();
+        mCollData.clear();
+        mExamData.clear();
+        mCateData.clear();
+        for(size_t i = 0, j; i < order.size(); i = j)
+        {
+            open();
+            for(j = i; j < order.size() && stored(records[order[j]].word) == stored(records[order[i]].word); ++j)
+            {
+                const SnapshotWord &b = records[order[j]], &e = records[order[j] + 1];
+                mDefiData.insert(mDefiData.end(), defi.begin() + b.defi, defi.begin() + e.defi);
+                mCollData.insert(mCollData.end(), coll.begin() + b.coll, coll.begin() + e.coll);
+                mExamData.insert(mExamData.end(), exam.begin() + b.exam, exam.begin() + e.exam);
+                mCateData.insert(mCateData.end(), cate.begin() + b.cate, cate.begin() + e.cate);
+            }
+            normalize();
+            SnapshotWord w = mOpen;
+            w.word = records[order[i]].word;
+            mIndexData.push_back(w);
+            stats.count(sc_merges, j - i - 1);
+        }
+    }
+
+    // adds the sentinel index entry and points the layout at the vectors
+    void                bind()
+    {
+        open();
+        mIndexData.push_back(mOpen);
+        mIndexData.shrink_to_fit();
+        mDefiData.shrink_to_fit();
+        mCollData.shrink_to_fit();
+        mExamData.shrink_to_fit();
+        mCateData.shrink_to_fit();
+        mStringData.shrink_to_fit();
+        mWords = mIndexData.size() - 1;
+        mIndex = mIndexData.data();
+        mDefi = mDefiData.data();
+        mColl = mCollData.data();
+        mExam = mExamData.data();
+        mCate = mCateData.data();
+        mStrings = mStringData.data();
+    }
+
+public:
+    FlatStore() = default;
+    FlatStore(const FlatStore&) = delete;
+    FlatStore& operator=(const FlatStore&) = delete;
+
+    // parses a whole dictionary text, returns the number of records read
+    size_t              load(std::string_view buf)
+    {
+        Record r{*this, std::string_view()};
+        size_t pos = 0, count = 0;
+        open();
+        while(parseWord(buf, pos, r) != parse_end)
+        {
+            ++count;
+            if(!r.word.empty()) commit(r.word);
+            else discard();
+            r.word = std::string_view();
+            open();
+        }
+        discard();
+        finish();
+        bind();
+        return count;
+    }
+
+    // lays out the words of a dictionary, already in order and deduplicated
+    template<class Dict>
+    void                build(const Dict &dictionary)
+    {
+        dictionary.forEach([&](const Word &w) {
+            open();
+            for(auto &d : w.defi) mDefiData.push_back({add(d.second), d.first, {}});
+            for(auto &c : w.coll) mCollData.push_back(add(c));
+            for(auto &e : w.exam) mExamData.push_back(add(e));
+            for(auto &c : w.cate) mCateData.push_back(intern(c));
+            commit(w.word);
+        });
+        bind();
+    }
+
+    size_t              bytes() const
+    {
+        return mIndexData.capacity() * sizeof(SnapshotWord) + mDefiData.capacity() * sizeof(SnapshotDefi)
+            + (mCollData.capacity() + mExamData.capacity() + mCateData.capacity()) * sizeof(SnapshotText) + mStringData.capacity();
+    }
+
+    // writes the layout as a snapshot file
+    bool                write(const char *path) const
+    {
+        if(mOverflow)
+        {
+            std::cerr << "dictionary too large for a snapshot." << std::endl;
+            return false;
+        }
+        SnapshotHeader h = {};
+        memcpy(h.magic, snapshot_magic, sizeof(snapshot_magic));
+        h.version = snapshot_version;
+        h.words = mWords;
+        h.index = sizeof(h);
+        h.defi = h.index + mIndexData.size() * sizeof(SnapshotWord);
+        h.coll = h.defi + mDefiData.size() * sizeof(SnapshotDefi);
+        h.exam = h.coll + mCollData.size() * sizeof(SnapshotText);
+        h.cate = h.exam + mExamData.size() * sizeof(SnapshotText);
+        h.strings = h.cate + mCateData.size() * sizeof(SnapshotText);
+        h.strings_size = mStringData.size();
+
+        std::ofstream file(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        file.write(reinterpret_cast<const char*>(mIndexData.data()), mIndexData.size() * sizeof(SnapshotWord));
+        file.write(reinterpret_cast<const char*>(mDefiData.data()), mDefiData.size() * sizeof(SnapshotDefi));
+        file.write(reinterpret_cast<const char*>(mCollData.data()), mCollData.size() * sizeof(SnapshotText));
+        file.write(reinterpret_cast<const char*>(mExamData.data()), mExamData.size() * sizeof(SnapshotText));
+        file.write(reinterpret_cast<const char*>(mCateData.data()), mCateData.size() * sizeof(SnapshotText));
+        file.write(mStringData.data(), mStringData.size());
+        // what is still buffered can fail too
+        file.close();
+        return bool(file);
+    }
+};
+
+// words left as text in the mapped dict. opening only scans for the blocks
+// of every head word; a word is parsed from its blocks when it is asked for,
+// and the Dictionary keeps it from then on. words that were never touched
+// are written back as the bytes they were read from.
+class LazyStore : public WordSource
+{
+    struct Block
+    {
+        std::string_view    word;
+        size_t              begin, end;     // from '[' to past ']'
+    };
+
+    FileView                mFile;
+    std::vector<Block>      mBlocks;    // sorted by head word, then position
+    std::vector<uint32_t>   mFirst;     // word i owns [mFirst[i], mFirst[i + 1]) of mBlocks
+
+public:
+    explicit LazyStore(const char *path) : mFile(path) {}
+
+    // finds the block of every record. returns false if a block does not
+    // start with a head word or is never closed, the file then has to be
+    // parsed in full to make sense of it.
+    bool                scan()
+    {
+        std::string_view buf = mFile.view();
+        for(size_t pos = 0;;)
+        {
+            while(pos < buf.size() && isspace(uint8_t(buf[pos]))) ++pos;
+            if(pos == buf.size()) break;
+            size_t begin = pos, head;
+            if(buf[pos++] != '[') return false;
+            while(pos < buf.size() && isspace(uint8_t(buf[pos]))) ++pos;
+            for(head = pos; pos < buf.size() && isalpha(uint8_t(buf[pos])); ++pos);
+            // ']' ends a block in every parser state, items cannot hold one
+            size_t end = buf.find(']', pos);
+            if(pos == head || end == std::string_view::npos) return false;
+            mBlocks.push_back({buf.substr(head, pos - head), begin, end + 1});
+            pos = end + 1;
+        }
+        // dict is written in order, duplicated head words are rare
+        auto less = [](const Block &a, const Block &b) { return a.word < b.word; };
+        if(!std::is_sorted(mBlocks.begin(), mBlocks.end(), less)) std::stable_sort(mBlocks.begin(), mBlocks.end(), less);
+        for(size_t k = 0; k < mBlocks.size(); ++k)
+            if(k == 0 || mBlocks[k].word != mBlocks[k - 1].word) mFirst.push_back(k);
+        mFirst.push_back(mBlocks.size());
+        return true;
+    }
+
+    size_t              records() const { return mBlocks.size(); }
+    size_t              size() const override { return mFirst.size() - 1; }
+    std::string_view    word(size_t i) const override { return mBlocks[mFirst[i]].word; }
+
+    Word                get(size_t i) const override
+    {
+        std::string_view buf = mFile.view();
+        Word w;
+        for(size_t k = mFirst[i]; k < mFirst[i + 1]; ++k)
+        {
+            // positions in diagnostics stay those of the file
+            size_t pos = mBlocks[k].begin;
+            parseWord(buf.substr(0, mBlocks[k].end), pos, w);
+        }
+        stats.count(sc_lazy_records, mFirst[i + 1] - mFirst[i]);
+        return w;
+    }
+
+    // the blocks of the i-th word as they are in the file
+    void                writeWord(size_t i, std::ostream &s) const override
+    {
+        std::string_view buf = mFile.view();
+        for(size_t k = mFirst[i]; k < mFirst[i + 1]; ++k)
+        {
+            s.write(buf.data() + mBlocks[k].begin, mBlocks[k].end - mBlocks[k].begin);
+            s.put('\n');
+        }
+    }
+};
+
+// compressed radix tree over head words. every node knows how many words
+// lie below it, so counting the words with a prefix only walks the prefix.
+class PrefixIndex
+{
+    struct Node
+    {
+        std::string                         label;      // edge from the parent
+        std::vector<std::unique_ptr<Node>>  children;   // ordered by label
+        size_t                              count = 0;  // words in this subtree
+        bool                                terminal = false;
+    };
+
+    Node mRoot;
+
+    static size_t common(std::string_view a, std::string_view b)
+    {
+        size_t n = 0;
+        while(n < a.size() && n < b.size() && a[n] == b[n]) ++n;
+        return n;
+    }
+
+    // child whose label starts with c, or the position to insert one at
+    static std::vector<std::unique_ptr<Node>>::iterator child(Node &n, char c)
+    {
+        return std::lower_bound(n.children.begin(), n.children.end(), c,
+            [](const std::unique_ptr<Node> &p, char c) { return p->label[0] < c; });
+    }
+
+    // node at which every word starting with prefix lies, with the part of
+    // prefix that runs into its label; nullptr if there is no such word
+    const Node*         locate(std::string_view prefix, std::string &path) const
+    {
+        const Node *n = &mRoot;
+        while(!prefix.empty())
+        {
+            auto i = child(const_cast<Node&>(*n), prefix[0]);
+            if(i == n->children.end() || (*i)->label[0] != prefix[0]) return nullptr;
+            size_t k = common((*i)->label, prefix);
+            if(k < prefix.size() && k < (*i)->label.size()) return nullptr;
+            n = i->get();
+            path += n->label;
+            prefix.remove_prefix(k);
+        }
+        return n;
+    }
+
+    // removes w below n, returns true if it was there
+    bool                erase(Node &n, std::string_view w)
+    {
+        if(w.empty())
+        {
+            if(!n.terminal) return false;
+            n.terminal = false;
+            --n.count;
+            return true;
+        }
+        auto i = child(n, w[0]);
+        if(i == n.children.end() || (*i)->label[0] != w[0] || w.compare(0, (*i)->label.size(), (*i)->label) != 0) return false;
+        Node &c = **i;
+        if(!erase(c, w.substr(c.label.size()))) return false;
+        --n.count;
+        if(c.count == 0)
+        {
+            n.children.erase(i);
+        }
+        else if(!c.terminal && c.children.size() == 1)
+        {
+            // fold the only grandchild into the child
+            std::unique_ptr<Node> g = std::move(c.children[0]);
+            g->label = c.label + g->label;
+            *i = std::move(g);
+        }
+        return true;
+    }
+
+public:
+    size_t              size() const { return mRoot.count; }
+
+    bool                contains(std::string_view w) const
+    {
+        std::string path;
+        const Node *n = locate(w, path);
+        return n && n->terminal && path.size() == w.size();
+    }
+
+    void                insert(std::string_view w)
+    {
+        if(contains(w)) return;
+        Node *n = &mRoot;
+        ++n->count;
+        while(!w.empty())
+        {
+            auto i = child(*n, w[0]);
+            if(i == n->children.end() || (*i)->label[0] != w[0])
+            {
+                auto leaf = std::make_unique<Node>();
+                leaf->label = w;
+                leaf->count = 1;
+                leaf->terminal = true;
+                n->children.insert(i, std::move(leaf));
+                return;
+            }
+            size_t k = common((*i)->label, w);
+            if(k < (*i)->label.size())
+            {
+                // split the edge where w leaves it
+                auto mid = std::make_unique<Node>();
+                mid->label = (*i)->label.substr(0, k);
+                mid->count = (*i)->count;
+                (*i)->label.erase(0, k);
+                mid->children.push_back(std::move(*i));
+                *i = std::move(mid);
+            }
+            n = i->get();
+            ++n->count;
+            w.remove_prefix(k);
+        }
+        n->terminal = true;
+    }
+
+    void                erase(std::string_view w) { erase(mRoot, w); }
+
+    // number of words starting with prefix
+    size_t              count(std::string_view prefix) const
+    {
+        std::string path;
+        const Node *n = locate(prefix, path);
+        return n ? n->count : 0;
+    }
+
+    // up to k words starting with prefix, shortest first, then in order
+    std::vector<std::string> complete(std::string_view prefix, size_t k) const
+    {
+        std::vector<std::string> r;
+        std::string path;
+        const Node *n = locate(prefix, path);
+        if(!n) return r;
+        typedef std::pair<std::string, const Node*> entry;
+        auto later = [](const entry &a, const entry &b) {
+            return a.first.size() != b.first.size() ? a.first.size() > b.first.size() : a.first > b.first;
+        };
+        std::priority_queue<entry, std::vector<entry>, decltype(later)> queue(later);
+        queue.emplace(std::move(path), n);
+        while(!queue.empty() && r.size() < k)
+        {
+            entry e = queue.top();
+            queue.pop();
+            if(e.second->terminal) r.push_back(e.first);
+            for(auto &c : e.second->children) queue.emplace(e.first + c->label, c.get());
+        }
+        return r;
+    }
+};
+
+// edit distance counting insertions, deletions, substitutions and swaps of
+// adjacent letters (optimal string alignment)
+size_t editDistance(std::string_view a, std::string_view b)
+{
+    const size_t m = b.size();
+    std::vector<size_t> rows(3 * (m + 1));
+    size_t *pprev = &rows[0], *prev = &rows[m + 1], *cur = &rows[2 * (m + 1)];
+    for(size_t j = 0; j <= m; ++j) prev[j] = j;
+    for(size_t i = 1; i <= a.size(); ++i)
+    {
+        cur[0] = i;
+        for(size_t j = 1; j <= m; ++j)
+        {
+            cur[j] = std::min({prev[j] + 1, cur[j - 1] + 1, prev[j - 1] + (a[i - 1] != b[j - 1])});
+            if(i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) cur[j] = std::min(cur[j], pprev[j - 2] + 1);
+        }
+        std::swap(pprev, prev);
+        std::swap(prev, cur);
+    }
+    return prev[m];
+}
+
+// head words as a character trie flattened in depth-first order. a search
+// for the words within k edits of a query is one forward scan over these
+// arrays, computing a row of the edit distance table per node and jumping
+// over every subtree whose row already exceeds k everywhere.
+class FuzzyIndex
+{
+    std::string             mChars;     // character of each node
+    std::vector<uint16_t>   mDepth;     // length of the node's path
+    std::vector<uint32_t>   mEnd;       // one past the node's subtree
+    std::vector<bool>       mTerminal;  // a word ends at the node
+    std::vector<uint32_t>   mOpen;      // nodes on the path of the last word
+    std::string             mLast;
+    size_t                  mMaxDepth = 0;
+
+    // search() computing a row of edit distances per node, for words too
+    // long for its bit sets
+    void                searchRows(std::string_view w, size_t k, std::vector<std::pair<size_t, std::string>> &found) const
+    {
+        const size_t m = w.size();
+        std::vector<size_t> rows((mMaxDepth + 1) * (m + 1));    // row d is for the node at depth d on the current path
+        std::string path(mMaxDepth, '\0');
+        for(size_t j = 0; j <= m; ++j) rows[j] = j;
+        for(size_t i = 0; i < mChars.size();)
+        {
+            size_t d = mDepth[i];
+            char c = path[d - 1] = mChars[i];
+            char before = d > 1 ? path[d - 2] : '\0';
+            size_t *cur = &rows[d * (m + 1)], *prev = cur - (m + 1);
+            // the row before prev, for transpositions
+            size_t *prev2 = d > 1 ? prev - (m + 1) : nullptr;
+            cur[0] = d;
+            size_t best = d;
+            for(size_t j = 1; j <= m; ++j)
+            {
+                size_t v = std::min(std::min(prev[j], cur[j - 1]) + 1, prev[j - 1] + (w[j - 1] != c));
+                if(j > 1 && d > 1 && c == w[j - 2] && before == w[j - 1]) v = std::min(v, prev2[j - 2] + 1);
+                cur[j] = v;
+                best = std::min(best, v);
+            }
+            if(best > k)
+            {
+                i = mEnd[i];
+                continue;
+            }
+            if(mTerminal[i] && cur[m] <= k) found.emplace_back(cur[m], path.substr(0, d));
+            ++i;
+        }
+    }
+
+public:
+    // words have to be appended in order
+    void                append(std::string_view w)
+    {
+        if(w.size() > UINT16_MAX) return;
+        size_t lcp = 0;
+        while(lcp < w.size() && lcp < mLast.size() && w[lcp] == mLast[lcp]) ++lcp;
+        for(; mOpen.size() > lcp; mOpen.pop_back()) mEnd[mOpen.back()] = mChars.size();
+        for(size_t d = lcp; d < w.size(); ++d)
+        {
+            mOpen.push_back(mChars.size());
+            mChars.push_back(w[d]);
+            mDepth.push_back(d + 1);
+            mEnd.push_back(0);
+            mTerminal.push_back(false);
+        }
+        if(!w.empty()) mTerminal[mOpen.back()] = true;
+        mMaxDepth = std::max(mMaxDepth, w.size());
+        mLast = w;
+    }
+
+    // closes the subtrees still open, call once after the last append
+    void                finish()
+    {
+        for(; !mOpen.empty(); mOpen.pop_back()) mEnd[mOpen.back()] = mChars.size();
+        mLast.clear();
+    }
+
+    // adds every word within k edits of w to found, with its distance.
+    // edits are insertions, deletions, substitutions and swaps of adjacent
+    // characters. every node on the path holds, for each e <= k, the set of
+    // prefix lengths of w its path is within e edits of, as the bits of a
+    // word; a child's sets take a few shifts and masks, whatever the length
+    // of w, and a subtree is skipped once the set for k is empty.
+    void                search(std::string_view w, size_t k, std::vector<std::pair<size_t, std::string>> &found) const
+    {
+        const size_t m = w.size();
+        if(m >= 62 || k >= 62)
+        {
+            searchRows(w, k, found);
+            return;
+        }
+        const uint64_t any = uint64_t(1) << 63;
+        uint64_t peq[256];          // bit j + 1 set where w[j] is the character, bit 63 always
+        std::fill(std::begin(peq), std::end(peq), any);
+        for(size_t j = 0; j < m; ++j) peq[uint8_t(w[j])] |= uint64_t(2) << j;
+        const uint64_t all = (uint64_t(2) << m) - 1;
+        std::vector<uint64_t> rows((mMaxDepth + 1) * (k + 1));  // sets of the node at depth d on the current path
+        for(size_t e = 0; e <= k; ++e) rows[e] = ((uint64_t(2) << e) - 1) & all;
+        // children of the node at depth d can only stay within k when their
+        // character matches one of these bits, bit 63 lets every child through
+        std::vector<uint64_t> next(mMaxDepth + 1, ~uint64_t(0));
+        std::string path(mMaxDepth, '\0');
+        for(size_t i = 0; i < mChars.size();)
+        {
+            size_t d = mDepth[i];
+            char c = path[d - 1] = mChars[i];
+            uint64_t match = peq[uint8_t(c)];
+            if(!(match & next[d - 1]))
+            {
+                i = mEnd[i];
+                continue;
+            }
+            const uint64_t *prev = &rows[(d - 1) * (k + 1)], *prev2 = d > 1 ? prev - (k + 1) : nullptr;
+            uint64_t *cur = &rows[d * (k + 1)];
+            // lengths j where c and the character before it are w[j - 1] and w[j - 2] swapped
+            uint64_t swapped = d > 1 ? (match << 1) & peq[uint8_t(path[d - 2])] : 0;
+            cur[0] = (prev[0] << 1) & match;
+            for(size_t e = 1; e <= k; ++e)
+            {
+                uint64_t r = ((prev[e] << 1) & match) | prev[e - 1] | (prev[e - 1] << 1) | (cur[e - 1] << 1);
+                if(swapped) r |= (prev2[e - 1] << 2) & swapped;
+                cur[e] = r & all;
+            }
+            if(cur[k] == 0)
+            {
+                i = mEnd[i];
+                continue;
+            }
+            // with nothing within k - 1 a child only stays within k by matching
+            // after a length in cur[k] or by swapping with this character
+            if(k == 0) next[d] = cur[0] << 1;
+            else if(cur[k - 1] == 0) next[d] = (cur[k] << 1) | (((prev[k - 1] << 2) & match) >> 1);
+            else next[d] = ~uint64_t(0);
+            if(mTerminal[i])
+            {
+                for(size_t e = 0; e <= k; ++e)
+                {
+                    if(!(cur[e] >> m & 1)) continue;
+                    found.emplace_back(e, path.substr(0, d));
+                    break;
+                }
+            }
+            ++i;
+        }
+    }
+};
+
+// item fields covered by full-text search
+enum text_field : uint8_t
+{
+    tf_defi,
+    tf_coll,
+    tf_exam,
+    text_field_count
+};
+
+constexpr const char *text_field_names[text_field_count] = {"defi", "coll", "exam"};
+
+struct TokenCharTable
+{
+    char fold[256];
+};
+
+// lowercase form of every byte that belongs to a token, 0 for separators
+constexpr TokenCharTable makeTokenCharTable()
+{
+    TokenCharTable t = {};
+    for(int c = 0; c < 256; ++c)
+    {
+        if(c >= 'A' && c <= 'Z') t.fold[c] = char(c - 'A' + 'a');
+        else if((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) t.fold[c] = char(c);
+    }
+    return t;
+}
+
+constexpr TokenCharTable token_chars = makeTokenCharTable();
+
+// calls f with every token of s, lowercased, and its position in s counted in
+// tokens. tokens are runs of letters, digits and non-ascii bytes.
+template<class F> void tokenizeText(std::string_view s, F &&f)
+{
+    char token[256];
+    size_t size = 0;
+    uint32_t pos = 0;
+    for(size_t i = 0; i <= s.size(); ++i)
+    {
+        char c = i < s.size() ? token_chars.fold[uint8_t(s[i])] : 0;
+        // overlong tokens are cut, nobody searches for them
+        if(c != 0)
+        {
+            if(size < sizeof(token)) token[size++] = c;
+            continue;
+        }
+        if(size == 0) continue;
+        f(std::string_view(token, size), pos++);
+        size = 0;
+    }
+}
+
+// a full-text query: words that all have to appear in one item, or in that
+// order next to each other when the query is quoted. a leading "defi:",
+// "coll:" or "exam:" limits the search to that kind of item.
+struct TextQuery
+{
+    std::vector<std::string>    terms;
+    bool                        phrase = false;
+    unsigned                    fields = (1u << text_field_count) - 1;
+
+    explicit TextQuery(std::string_view q)
+    {
+        while(!q.empty() && isspace(uint8_t(q.front()))) q.remove_prefix(1);
+        for(size_t f = 0; f < text_field_count; ++f)
+        {
+            std::string_view name = text_field_names[f];
+            if(q.substr(0, name.size()) == name && q.substr(name.size(), 1) == ":")
+            {
+                fields = 1u << f;
+                q.remove_prefix(name.size() + 1);
+                break;
+            }
+        }
+        while(!q.empty() && isspace(uint8_t(q.front()))) q.remove_prefix(1);
+        while(!q.empty() && isspace(uint8_t(q.back()))) q.remove_suffix(1);
+        phrase = q.size() > 1 && q.front() == '"' && q.back() == '"';
+        tokenizeText(q, [&](std::string_view t, uint32_t) { terms.emplace_back(t); });
+    }
+
+    // true if the text of an item of the given field satisfies the query
+    bool                        matches(text_field field, std::string_view text) const
+    {
+        if(!(fields & (1u << field)) || terms.empty()) return false;
+        std::vector<std::string> tokens;
+        tokenizeText(text, [&](std::string_view t, uint32_t) { tokens.emplace_back(t); });
+        if(phrase) return std::search(tokens.begin(), tokens.end(), terms.begin(), terms.end()) != tokens.end();
+        for(auto &t : terms)
+            if(std::find(tokens.begin(), tokens.end(), t) == tokens.end()) return false;
+        return true;
+    }
+};
+
+// inverted index over the text of definitions, collocations and examples.
+// every item indexed gets an id, and every token a posting (item, position)
+// in the list of its term. ids only grow, so lists stay sorted by just
+// appending; removing a word retires its document and the postings of
+// retired documents are skipped by queries.
+class TextIndex
+{
+    struct Posting
+    {
+        uint32_t    item;
+        uint32_t    pos;
+
+        bool operator<(const Posting &p) const { return item != p.item ? item < p.item : pos < p.pos; }
+    };
+
+    struct Item
+    {
+        uint32_t    doc;
+        text_field  field;
+    };
+
+    // terms are interned in an open-addressing table: slots hold term id + 1,
+    // the text of all terms lives in one buffer
+    std::vector<uint32_t>                       mSlots;
+    std::string                                 mTermText;
+    std::vector<std::pair<uint32_t, uint32_t>>  mTermRefs;  // (offset, size) in mTermText, by term id
+    std::vector<uint32_t>                       mTermHashes;
+    std::vector<std::vector<Posting>>           mPostings;  // by term id
+    std::vector<Item>                           mItems;     // by item id
+    std::vector<std::string>                    mDocs;      // head word of every document
+    std::vector<bool>                           mRetired;
+    std::unordered_map<std::string, uint32_t>   mDocIds;    // live document of a head word
+
+    static uint32_t     hashTerm(std::string_view t)
+    {
+        uint32_t h = 2166136261u;
+        for(char c : t) h = (h ^ uint8_t(c)) * 16777619u;
+        return h;
+    }
+
+    // slot holding t, or the empty slot where it would go
+    size_t              slotOf(std::string_view t, uint32_t hash) const
+    {
+        size_t mask = mSlots.size() - 1;
+        for(size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            uint32_t id = mSlots[i];
+            if(id == 0) return i;
+            auto &ref = mTermRefs[id - 1];
+            if(mTermHashes[id - 1] == hash && std::string_view(mTermText.data() + ref.first, ref.second) == t) return i;
+        }
+    }
+
+    // id of t, or -1 if it was never indexed
+    int64_t             findTerm(std::string_view t) const
+    {
+        if(mSlots.empty()) return -1;
+        uint32_t id = mSlots[slotOf(t, hashTerm(t))];
+        return int64_t(id) - 1;
+    }
+
+    uint32_t            internTerm(std::string_view t)
+    {
+        // keep the table at most half full
+        if(2 * (mTermRefs.size() + 1) > mSlots.size())
+        {
+            std::vector<uint32_t> old(std::max<size_t>(1024, 2 * mSlots.size()), 0);
+            old.swap(mSlots);
+            for(uint32_t id : old)
+            {
+                if(id == 0) continue;
+                size_t mask = mSlots.size() - 1, i = mTermHashes[id - 1] & mask;
+                while(mSlots[i] != 0) i = (i + 1) & mask;
+                mSlots[i] = id;
+            }
+        }
+        uint32_t hash = hashTerm(t);
+        size_t slot = slotOf(t, hash);
+        if(mSlots[slot] == 0)
+        {
+            mTermRefs.emplace_back(mTermText.size(), t.size());
+            mTermText.append(t);
+            mTermHashes.push_back(hash);
+            mPostings.emplace_back();
+            mSlots[slot] = mTermRefs.size();
+        }
+        return mSlots[slot] - 1;
+    }
+
+    void                addItem(uint32_t doc, text_field field, std::string_view text)
+    {
+        uint32_t item = mItems.size();
+        mItems.push_back(Item{doc, field});
+        tokenizeText(text, [&](std::string_view t, uint32_t pos) {
+            mPostings[internTerm(t)].push_back(Posting{item, pos});
+        });
+    }
+
+public:
+    // indexes the items of w, added to the word of the same head word if any
+    void                add(const Word &w)
+    {
+        auto d = mDocIds.emplace(w.word, mDocs.size());
+        if(d.second)
+        {
+            mDocs.push_back(w.word);
+            mRetired.push_back(false);
+        }
+        uint32_t doc = d.first->second;
+        for(auto &i : w.defi) addItem(doc, tf_defi, i.second);
+        for(auto &i : w.coll) addItem(doc, tf_coll, i);
+        for(auto &i : w.exam) addItem(doc, tf_exam, i);
+    }
+
+    void                remove(const std::string &w)
+    {
+        auto d = mDocIds.find(w);
+        if(d == mDocIds.end()) return;
+        mRetired[d->second] = true;
+        mDocIds.erase(d);
+    }
+
+    // head words with an item satisfying q, in order. checks the postings
+    // of the rarest term against the others with binary searches, so the
+    // cost follows the shortest list rather than the longest.
+    std::vector<std::string> find(const TextQuery &q) const
+    {
+        std::vector<const std::vector<Posting>*> lists;
+        for(auto &t : q.terms)
+        {
+            int64_t id = findTerm(t);
+            if(id < 0) return {};
+            lists.push_back(&mPostings[id]);
+        }
+        if(lists.empty()) return {};
+        size_t rare = 0;
+        for(size_t i = 1; i < lists.size(); ++i)
+            if(lists[i]->size() < lists[rare]->size()) rare = i;
+        std::vector<std::vector<Posting>::const_iterator> cursors;
+        for(auto l : lists) cursors.push_back(l->begin());
+        std::vector<uint32_t> docs;
+        for(auto &p : *lists[rare])
+        {
+            const Item &item = mItems[p.item];
+            if(mRetired[item.doc] || !(q.fields & (1u << item.field))) continue;
+            if(!docs.empty() && docs.back() == item.doc) continue;
+            if(q.phrase && p.pos < rare) continue;
+            bool found = true;
+            for(size_t i = 0; found && i < lists.size(); ++i)
+            {
+                if(i == rare) continue;
+                Posting want{p.item, q.phrase ? uint32_t(p.pos - rare + i) : 0};
+                cursors[i] = std::lower_bound(cursors[i], lists[i]->end(), want);
+                auto &c = cursors[i];
+                found = c != lists[i]->end() && c->item == p.item && (!q.phrase || c->pos == want.pos);
+            }
+            if(found) docs.push_back(item.doc);
+        }
+        std::vector<std::string> r;
+        for(auto d : docs) r.push_back(mDocs[d]);
+        std::sort(r.begin(), r.end());
+        r.erase(std::unique(r.begin(), r.end()), r.end());
+        return r;
+    }
+};
+
+// compressed set of 32-bit word ids in the manner of roaring bitmaps: ids
+// are grouped by their high 16 bits into containers holding the low bits,
+// as a sorted array while there are at most 4096 of them, as a 65536-bit
+// bitmap past that
+class WordBitmap
+{
+    static const size_t     array_limit = 4096;
+    static const size_t     bitmap_words = 65536 / 64;
+
+    struct Container
+    {
+        uint16_t                key = 0;
+        uint32_t                count = 0;
+        std::vector<uint16_t>   array;  // while sparse
+        std::vector<uint64_t>   bits;   // once dense
+
+        bool                    dense() const { return !bits.empty(); }
+
+        bool                    contains(uint16_t v) const
+        {
+            if(dense()) return bits[v >> 6] >> (v & 63) & 1;
+            return std::binary_search(array.begin(), array.end(), v);
+        }
+
+        std::vector<uint64_t>   toBits() const
+        {
+            if(dense()) return bits;
+            std::vector<uint64_t> b(bitmap_words);
+            for(uint16_t v : array) b[v >> 6] |= uint64_t(1) << (v & 63);
+            return b;
+        }
+
+        // takes b as content, in whichever form suits its population
+        void                    setBits(std::vector<uint64_t> &&b)
+        {
+            count = 0;
+            for(uint64_t w : b) count += __builtin_popcountll(w);
+            array.clear();
+            bits.clear();
+            if(count > array_limit)
+            {
+                bits = std::move(b);
+                return;
+            }
+            array.reserve(count);
+            for(size_t i = 0; i < bitmap_words; ++i)
+                for(uint64_t w = b[i]; w; w &= w - 1) array.push_back(uint16_t(i * 64 + __builtin_ctzll(w)));
+        }
+
+        template<class F> void  forEach(F &&f) const
+        {
+            uint32_t high = uint32_t(key) << 16;
+            if(!dense())
+            {
+                for(uint16_t v : array) f(high | v);
+                return;
+            }
+            for(size_t i = 0; i < bitmap_words; ++i)
+                for(uint64_t w = bits[i]; w; w &= w - 1) f(high | uint32_t(i * 64 + __builtin_ctzll(w)));
+        }
+    };
+
+    std::vector<Container>  mContainers;    // ordered by key
+
+    Container*              container(uint16_t key)
+    {
+        auto i = std::lower_bound(mContainers.begin(), mContainers.end(), key, [](const Container &c, uint16_t k) { return c.key < k; });
+        return (i != mContainers.end() && i->key == key) ? &*i : nullptr;
+    }
+
+    const Container*        container(uint16_t key) const { return const_cast<WordBitmap*>(this)->container(key); }
+
+    enum set_op { op_and, op_or, op_and_not };
+
+    static Container        combine(const Container &a, const Container &b, set_op op)
+    {
+        Container r;
+        r.key = a.key;
+        if(!a.dense() && (op == op_and || op == op_and_not))
+        {
+            // probing the other side keeps sparse results cheap
+            for(uint16_t v : a.array)
+                if(b.contains(v) == (op == op_and)) r.array.push_back(v);
+            r.count = r.array.size();
+            return r;
+        }
+        if(!a.dense() && !b.dense())
+        {
+            std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(r.array));
+            r.count = r.array.size();
+            if(r.count > array_limit)
+            {
+                std::vector<uint64_t> bits = r.toBits();
+                r.setBits(std::move(bits));
+            }
+            return r;
+        }
+        std::vector<uint64_t> x = a.toBits(), y = b.toBits();
+        for(size_t i = 0; i < bitmap_words; ++i)
+            x[i] = op == op_and ? (x[i] & y[i]) : op == op_or ? (x[i] | y[i]) : (x[i] & ~y[i]);
+        r.setBits(std::move(x));
+        return r;
+    }
+
+    static WordBitmap       combine(const WordBitmap &a, const WordBitmap &b, set_op op)
+    {
+        WordBitmap r;
+        auto i = a.mContainers.begin(), j = b.mContainers.begin();
+        while(i != a.mContainers.end() || j != b.mContainers.end())
+        {
+            bool has_a = i != a.mContainers.end(), has_b = j != b.mContainers.end();
+            if(has_a && (!has_b || i->key < j->key))
+            {
+                if(op != op_and) r.mContainers.push_back(*i);
+                ++i;
+            }
+            else if(!has_a || j->key < i->key)
+            {
+                if(op == op_or) r.mContainers.push_back(*j);
+                ++j;
+            }
+            else
+            {
+                Container c = combine(*i++, *j++, op);
+                if(c.count) r.mContainers.push_back(std::move(c));
+            }
+        }
+        return r;
+    }
+
+public:
+    void                    add(uint32_t id)
+    {
+        uint16_t key = id >> 16, v = id & 0xffff;
+        Container *c = container(key);
+        if(c == nullptr)
+        {
+            auto i = std::lower_bound(mContainers.begin(), mContainers.end(), key, [](const Container &c, uint16_t k) { return c.key < k; });
+            c = &*mContainers.emplace(i);
+            c->key = key;
+        }
+        if(c->dense())
+        {
+            uint64_t &w = c->bits[v >> 6], bit = uint64_t(1) << (v & 63);
+            if(!(w & bit)) ++c->count;
+            w |= bit;
+            return;
+        }
+        auto i = std::lower_bound(c->array.begin(), c->array.end(), v);
+        if(i != c->array.end() && *i == v) return;
+        c->array.insert(i, v);
+        if(++c->count > array_limit) c->setBits(c->toBits());
+    }
+
+    void                    remove(uint32_t id)
+    {
+        Container *c = container(id >> 16);
+        uint16_t v = id & 0xffff;
+        if(c == nullptr || !c->contains(v)) return;
+        if(c->dense())
+        {
+            c->bits[v >> 6] &= ~(uint64_t(1) << (v & 63));
+            if(--c->count <= array_limit)
+            {
+                std::vector<uint64_t> bits = std::move(c->bits);
+                c->setBits(std::move(bits));
+            }
+        }
+        else
+        {
+            c->array.erase(std::lower_bound(c->array.begin(), c->array.end(), v));
+            --c->count;
+        }
+        if(c->count == 0) mContainers.erase(mContainers.begin() + (c - mContainers.data()));
+    }
+
+    bool                    contains(uint32_t id) const
+    {
+        const Container *c = container(id >> 16);
+        return c != nullptr && c->contains(id & 0xffff);
+    }
+
+    size_t                  count() const
+    {
+        size_t n = 0;
+        for(auto &c : mContainers) n += c.count;
+        return n;
+    }
+
+    // calls f with every id, in increasing order
+    template<class F> void  forEach(F &&f) const
+    {
+        for(auto &c : mContainers) c.forEach(f);
+    }
+
+    friend WordBitmap       operator&(const WordBitmap &a, const WordBitmap &b) { return combine(a, b, op_and); }
+    friend WordBitmap       operator|(const WordBitmap &a, const WordBitmap &b) { return combine(a, b, op_or); }
+    friend WordBitmap       operator-(const WordBitmap &a, const WordBitmap &b) { return combine(a, b, op_and_not); }
+};
+
+// the words of every category as a bitmap of word ids. ids are handed out
+// in the order words are indexed, removed words only leave the live set.
+class CategoryIndex
+{
+    WordArena                                   mArena;
+    StringPool                                  mNames{mArena};     // category names
+    std::vector<WordBitmap>                     mCategories;        // by category id
+    std::vector<std::string>                    mWords;             // head word of every id
+    std::unordered_map<std::string, uint32_t>   mIds;               // live id of a head word
+    WordBitmap                                  mLive;
+
+    // parses and evaluates "a & b | !c": ! binds tighter than &, & tighter
+    // than |, parentheses group and "double quotes" hold a name with spaces
+    // or operators. unknown categories are empty. sets error and stops at
+    // the first thing that does not fit, q then starts there.
+    WordBitmap                  parse(std::string_view &q, int level, const char *&error) const
+    {
+        auto skip = [&] { while(!q.empty() && isspace(uint8_t(q.front()))) q.remove_prefix(1); };
+        skip();
+        if(level == 0 || level == 1)
+        {
+            WordBitmap r = parse(q, level + 1, error);
+            char op = level == 0 ? '|' : '&';
+            for(skip(); error == nullptr && !q.empty() && q.front() == op; skip())
+            {
+                q.remove_prefix(1);
+                WordBitmap rhs = parse(q, level + 1, error);
+                r = op == '|' ? (r | rhs) : (r & rhs);
+            }
+            return r;
+        }
+        if(!q.empty() && q.front() == '!')
+        {
+            q.remove_prefix(1);
+            return mLive - parse(q, level, error);
+        }
+        if(!q.empty() && q.front() == '(')
+        {
+            q.remove_prefix(1);
+            WordBitmap r = parse(q, 0, error);
+            if(error) return r;
+            skip();
+            if(q.empty() || q.front() != ')')
+            {
+                error = "'(' is not closed";
+                return r;
+            }
+            q.remove_prefix(1);
+            return r;
+        }
+        std::string_view name;
+        if(!q.empty() && q.front() == '"')
+        {
+            size_t end = q.find('"', 1);
+            if(end == std::string_view::npos)
+            {
+                error = "'\"' is not closed";
+                return WordBitmap();
+            }
+            name = q.substr(1, end - 1);
+            q.remove_prefix(end + 1);
+        }
+        else
+        {
+            size_t n = 0;
+            while(n < q.size() && !isspace(uint8_t(q[n])) && !strchr("&|!()\"", q[n])) ++n;
+            if(n == 0)
+            {
+                error = "category name expected";
+                return WordBitmap();
+            }
+            name = q.substr(0, n);
+            q.remove_prefix(n);
+        }
+        uint32_t cate = mNames.find(name);
+        return cate < mCategories.size() ? mCategories[cate] & mLive : WordBitmap();
+    }
+
+public:
+    // records the categories of w, added to those of the word of the same
+    // head word if any
+    void                        add(const Word &w)
+    {
+        auto i = mIds.emplace(w.word, mWords.size());
+        if(i.second) mWords.push_back(w.word);
+        uint32_t id = i.first->second;
+        mLive.add(id);
+        for(auto &c : w.cate)
+        {
+            uint32_t cate = mNames.intern(c);
+            if(cate == mCategories.size()) mCategories.emplace_back();
+            mCategories[cate].add(id);
+        }
+    }
+
+    void                        remove(const std::string &w)
+    {
+        auto i = mIds.find(w);
+        if(i == mIds.end()) return;
+        mLive.remove(i->second);
+        mIds.erase(i);
+    }
+
+    // evaluates the expression q. if it is malformed, sets error to where
+    // and why and returns no words.
+    WordBitmap                  query(std::string_view q, std::string &error) const
+    {
+        std::string_view rest = q;
+        const char *message = nullptr;
+        WordBitmap r = parse(rest, 0, message);
+        while(!rest.empty() && isspace(uint8_t(rest.front()))) rest.remove_prefix(1);
+        if(message == nullptr && !rest.empty()) message = rest.front() == ')' ? "')' without '('" : "'&' or '|' expected";
+        if(message == nullptr) return r;
+        error = "column " + std::to_string(q.size() - rest.size() + 1) + ": " + message;
+        return WordBitmap();
+    }
+
+    std::string_view            word(uint32_t id) const { return mWords[id]; }
+};
+
+// the words of a session: an optional read-only base (snapshot, arena), plus
+// the words parsed from text or touched in this session, which shadow it.
+class Dictionary
+{
+    std::map<std::string, Word>     mWords;
+    std::set<std::string>           mRemoved;   // base words erased in this session
+    std::shared_ptr<const WordSource> mBase;
+    std::unique_ptr<PrefixIndex>    mNames;     // built on the first prefix query
+    std::unique_ptr<FuzzyIndex>     mFuzzy;     // built on the first fuzzy query
+    std::vector<std::string>        mFuzzyAdded; // words created since mFuzzy was built
+    std::unique_ptr<TextIndex>      mText;      // built on the first text search
+    std::unique_ptr<CategoryIndex>  mCategories; // built on the first category query
+
+    PrefixIndex&                    names()
+    {
+        if(!mNames)
+        {
+            mNames = std::make_unique<PrefixIndex>();
+            forEachName(std::string(), [&](std::string_view w) { mNames->insert(w); });
+        }
+        return *mNames;
+    }
+
+    TextIndex&                      text()
+    {
+        if(!mText)
+        {
+            mText = std::make_unique<TextIndex>();
+            forEach([&](const Word &w) { mText->add(w); });
+        }
+        return *mText;
+    }
+
+    CategoryIndex&                  categories()
+    {
+        if(!mCategories)
+        {
+            mCategories = std::make_unique<CategoryIndex>();
+            forEach([&](const Word &w) { mCategories->add(w); });
+        }
+        return *mCategories;
+    }
+
+    // copies a base word into mWords so it can be handed out for editing
+    Word*                           materialize(const std::string &w)
+    {
+        if(!mBase || mRemoved.count(w)) return nullptr;
+        size_t i = mBase->find(w);
+        if(i == mBase->size()) return nullptr;
+        return &mWords.emplace(w, mBase->get(i)).first->second;
+    }
+
+public:
+    std::map<std::string, Word>&    words() { return mWords; }
+    const WordSource*               base() const { return mBase.get(); }
+    std::shared_ptr<const WordSource> sharedBase() const { return mBase; }
+    void                            setBase(std::unique_ptr<WordSource> base) { mBase = std::move(base); }
+
+    bool                            openSnapshot(const char *path)
+    {
+        auto s = std::make_unique<Snapshot>(path);
+        if(!s->good()) return false;
+        mBase = std::move(s);
+        return true;
+    }
+
+    bool                            contains(const std::string &w) const
+    {
+        return mWords.count(w) || (mBase && mBase->find(w) != mBase->size() && !mRemoved.count(w));
+    }
+
+    Word*                           find(const std::string &w)
+    {
+        auto i = mWords.find(w);
+        return i != mWords.end() ? &i->second : materialize(w);
+    }
+
+    // like std::map::operator[], a new word is returned with an empty head word
+    Word&                           operator[](const std::string &w)
+    {
+        if(Word *p = find(w)) return *p;
+        mRemoved.erase(w);
+        if(mNames) mNames->insert(w);
+        if(mFuzzy) mFuzzyAdded.push_back(w);
+        return mWords[w];
+    }
+
+    bool                            erase(const std::string &w)
+    {
+        bool in_base = mBase && !mRemoved.count(w) && mBase->find(w) != mBase->size();
+        if(in_base) mRemoved.insert(w);
+        bool erased = mWords.erase(w) > 0 || in_base;
+        if(erased && mNames) mNames->erase(w);
+        if(erased && mText) mText->remove(w);
+        if(erased && mCategories) mCategories->remove(w);
+        return erased;
+    }
+
+    // lays out every word in a new flat base and empties the overlay, so the
+    // base holds the whole dictionary and can be shared
+    void                            rebase()
+    {
+        if(mBase && mWords.empty() && mRemoved.empty()) return;
+        auto flat = std::make_shared<FlatStore>();
+        flat->build(*this);
+        mBase = std::move(flat);
+        mWords.clear();
+        mRemoved.clear();
+    }
+
+    // keeps the text and category indexes in step with items added to a
+    // word obtained through operator[] or find
+    void                            itemsAdded(const Word &added)
+    {
+        if(mText) mText->add(added);
+        if(mCategories) mCategories->add(added);
+    }
+
+    // head words with an item satisfying q, in order
+    std::vector<std::string>        search(const TextQuery &q) { return text().find(q); }
+
+    // calls f with every head word whose categories satisfy the expression q,
+    // returns their number. error is set if q is malformed.
+    template<class F> size_t        forEachInCategories(std::string_view q, std::string &error, F &&f)
+    {
+        CategoryIndex &index = categories();
+        WordBitmap words = index.query(q, error);
+        words.forEach([&](uint32_t id) { f(index.word(id)); });
+        return words.count();
+    }
+
+    // number of head words starting with prefix
+    size_t                          countPrefixed(const std::string &prefix) { return names().count(prefix); }
+
+    // up to limit head words starting with prefix, shortest first
+    std::vector<std::string>        suggest(const std::string &prefix, size_t limit) { return names().complete(prefix, limit); }
+
+    // up to limit head words within k edits of w, closest first
+    std::vector<std::string>        fuzzy(const std::string &w, size_t k, size_t limit)
+    {
+        // words added later are checked one by one until there are enough
+        // of them to make rebuilding worth it; erased ones are filtered out
+        if(!mFuzzy || mFuzzyAdded.size() > 256)
+        {
+            mFuzzy = std::make_unique<FuzzyIndex>();
+            forEachName(std::string(), [&](std::string_view n) { mFuzzy->append(n); });
+            mFuzzy->finish();
+            mFuzzyAdded.clear();
+        }
+        std::vector<std::pair<size_t, std::string>> found;
+        mFuzzy->search(w, k, found);
+        for(auto &a : mFuzzyAdded)
+        {
+            size_t d = editDistance(a, w);
+            if(d <= k) found.emplace_back(d, a);
+        }
+        std::sort(found.begin(), found.end(), [](const std::pair<size_t, std::string> &a, const std::pair<size_t, std::string> &b) {
+            if(a.first != b.first) return a.first < b.first;
+            return a.second.size() != b.second.size() ? a.second.size() < b.second.size() : a.second < b.second;
+        });
+        std::vector<std::string> r;
+        for(auto &f : found)
+        {
+            if(r.size() == limit) break;
+            if(std::find(r.begin(), r.end(), f.second) == r.end() && contains(f.second)) r.push_back(std::move(f.second));
+        }
+        return r;
+    }
+
+    // calls f with every head word starting with prefix, in order
+    template<class F> void          forEachName(const std::string &prefix, F &&f) const
+    {
+        auto i = mWords.lower_bound(prefix);
+        size_t s = mBase ? mBase->lowerBound(prefix) : 0, send = mBase ? mBase->size() : 0;
+        for(;;)
+        {
+            bool has_map = i != mWords.end() && i->first.compare(0, prefix.size(), prefix) == 0;
+            bool has_base = s < send && mBase->word(s).substr(0, prefix.size()) == prefix;
+            if(has_base && (mRemoved.count(std::string(mBase->word(s)))
+                || (has_map && mBase->word(s) == i->first)))
+            {
+                ++s;
+                continue;
+            }
+            if(has_map && (!has_base || i->first < mBase->word(s))) f(std::string_view((i++)->first));
+            else if(has_base) f(mBase->word(s++));
+            else break;
+        }
+    }
+
+    // calls on_word with every word of mWords and on_base with the index of
+    // every visible base word, in order
+    template<class FW, class FB> void walk(FW &&on_word, FB &&on_base) const
+    {
+        auto i = mWords.begin();
+        size_t s = 0, send = mBase ? mBase->size() : 0;
+        while(i != mWords.end() || s < send)
+        {
+            if(s < send && (i == mWords.end() || mBase->word(s) < i->first))
+            {
+                if(mRemoved.empty() || !mRemoved.count(std::string(mBase->word(s)))) on_base(s);
+                ++s;
+                continue;
+            }
+            if(s < send && mBase->word(s) == i->first) ++s;
+            on_word(i->second);
+            ++i;
+        }
+    }
+
+    // calls f with every word in order, base words are built on the fly
+    template<class F> void          forEach(F &&f) const
+    {
+        walk(f, [&](size_t s) { f(mBase->get(s)); });
+    }
+
+    // writes every word in dict format
+    void                            write(std::ostream &s) const
+    {
+        walk([&](const Word &w) { s << w; }, [&](size_t i) { mBase->writeWord(i, s); });
+    }
+};
+
+// writes every word of the dictionary as a binary snapshot
+bool writeSnapshot(const char *path, const Dictionary &dictionary)
+{
+    FlatStore flat;
+    flat.build(dictionary);
+    return flat.write(path);
+}
+
+// true if the snapshot exists and is at least as recent as the text dictionary
+bool snapshotIsFresh(const char *snapshot, const char *text)
+{
+    struct stat ss, ts;
+    if(stat(snapshot, &ss) != 0) return false;
+    if(stat(text, &ts) != 0) return true;
+    return std::make_pair(ss.st_mtim.tv_sec, ss.st_mtim.tv_nsec) >= std::make_pair(ts.st_mtim.tv_sec, ts.st_mtim.tv_nsec);
+}
+
+// append-only log of the edits made since dict was last rewritten. records
+// are "+" followed by a word block holding the added items, or "-" followed
+// by a removed head word and a newline. each record is written with a single
+// write() and synced, so a crash loses at most the record being written.
+class Journal
+{
+    int         mFd = -1;
+    std::string mPath;
+    std::mutex  mLock;  // appends against rotate()
+
+    void    append(const std::string &record)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if(mFd < 0) return;
+        if(write(mFd, record.data(), record.size()) != ssize_t(record.size()) || fdatasync(mFd) != 0)
+        {
+            std::cerr << "failed to write journal record." << std::endl;
+        }
+    }
+
+public:
+    Journal() = default;
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+    ~Journal()
+    {
+        if(mFd >= 0) ::close(mFd);
+    }
+
+    // opens the journal for appending, dropping everything past valid_size
+    // (a record torn by a crash)
+    bool    open(const char *path, off_t valid_size)
+    {
+        mPath = path;
+        mFd = ::open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+        if(mFd < 0)
+        {
+            std::cerr << "cannot open journal '" << path << "'." << std::endl;
+            return false;
+        }
+        if(size() > valid_size && ftruncate(mFd, valid_size) != 0)
+        {
+            std::cerr << "cannot truncate journal." << std::endl;
+        }
+        return true;
+    }
+
+    void    add(const Word &delta)
+    {
+        std::ostringstream s;
+        s << "+" << delta;
+        append(s.str());
+    }
+
+    // records many deltas with one write and one sync
+    void    add(const std::map<std::string, Word> &deltas)
+    {
+        std::ostringstream s;
+        for(auto &d : deltas) s << "+" << d.second;
+        if(!deltas.empty()) append(s.str());
+    }
+
+    void    remove(const std::string &word)
+    {
+        append("-" + word + "\n");
+    }
+
+    off_t   size() const
+    {
+        struct stat st;
+        return (mFd >= 0 && fstat(mFd, &st) == 0) ? st.st_size : 0;
+    }
+
+    // renames the records written so far to path and goes on in an empty
+    // journal. returns false if there were none or they could not be moved.
+    bool    rotate(const char *path)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        struct stat st;
+        if(mFd < 0 || fstat(mFd, &st) != 0 || st.st_size == 0) return false;
+        if(rename(mPath.c_str(), path) != 0)
+        {
+            std::cerr << "cannot move journal to '" << path << "'." << std::endl;
+            return false;
+        }
+        ::close(mFd);
+        mFd = ::open(mPath.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        if(mFd < 0) std::cerr << "cannot open journal '" << mPath << "'." << std::endl;
+        return true;
+    }
+};
+
+// fsyncs the directory holding path, so the renames and new files in it
+// are on disk
+bool syncDirectory(const char *path)
+{
+    std::string dir(path);
+    size_t slash = dir.rfind('/');
+    dir = slash == std::string::npos ? "." : dir.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if(fd < 0) return false;
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+// calls on_add with the delta of every "+" record and on_remove with the
+// head word of every "-" record in buf, in order. returns the length of
+// the journal up to the last complete record.
+template<class FA, class FR> size_t readJournal(std::string_view buf, FA &&on_add, FR &&on_remove)
+{
+    size_t pos = 0, valid = 0;
+    while(pos < buf.size())
+    {
+        char c = buf[pos];
+        if(isspace(c))
+        {
+            ++pos;
+            continue;
+        }
+        if(c == '+')
+        {
+            Word delta;
+            parse_result r = parseWord(buf, ++pos, delta);
+            if(r == parse_end) break;
+            valid = pos;
+            if(r == parse_ok && !delta.word.empty()) on_add(delta);
+            continue;
+        }
+        if(c == '-')
+        {
+            size_t end = buf.find('\n', pos);
+            if(end == std::string_view::npos) break;
+            on_remove(std::string(buf.substr(pos + 1, end - pos - 1)));
+            valid = pos = end + 1;
+            continue;
+        }
+        std::cerr << "unexpected character in journal at position " << pos << std::endl;
+        valid = ++pos;
+    }
+    return valid;
+}
+
+// applies the records of a journal file to dictionary in order.
+// returns the length of the journal up to the last complete record.
+off_t replayJournal(const char *path, Dictionary &dictionary)
+{
+    FileView file(path);
+    return readJournal(file.view(), [&](Word &delta) {
+        stats.count(sc_journal_records);
+        Word &w = dictionary[delta.word];
+        if(w.word.empty()) w.word = delta.word;
+        w.merge(delta);
+        dictionary.itemsAdded(delta);
+    }, [&](const std::string &word) {
+        stats.count(sc_journal_records);
+        dictionary.erase(word);
+    });
+}
+
+// 128-bit content hash used to address backup chunks
+struct BackupHash
+{
+    uint64_t a, b;
+
+    bool operator==(const BackupHash &h) const { return a == h.a && b == h.b; }
+};
+
+struct BackupHashHasher
+{
+    size_t operator()(const BackupHash &h) const { return h.a; }
+};
+
+static inline uint64_t mix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+BackupHash hashBytes(std::string_view s)
+{
+    uint64_t a = 0xcbf29ce484222325ULL ^ s.size(), b = 0x9e3779b97f4a7c15ULL + s.size();
+    size_t i = 0;
+    for(; i + 8 <= s.size(); i += 8)
+    {
+        uint64_t k;
+        memcpy(&k, s.data() + i, 8);
+        a = mix64(a ^ k) * 0x100000001b3ULL;
+        b = ((b ^ (k * 0x87c37b91114253d5ULL)) << 31 | b >> 33) * 0x4cf5ad432745937fULL;
+    }
+    uint64_t k = 0;
+    memcpy(&k, s.data() + i, s.size() - i);
+    return BackupHash{mix64(a ^ k ^ b), mix64(b ^ mix64(k) ^ a)};
+}
+
+struct BackupChunk
+{
+    BackupHash  hash;
+    uint64_t    offset;
+    uint64_t    size;
+};
+
+struct BackupManifest
+{
+    char        magic[8];
+    int64_t     time;
+    uint64_t    size;
+    uint64_t    chunks;
+};
+
+static const char backup_magic[8] = {'V', 'O', 'C', 'B', 'A', 'C', 'K', '\0'};
+
+// keeps every version of dict as a list of content-addressed chunks, so a
+// new generation only costs the chunks that changed. in the store directory:
+//   pack       chunk contents, appended
+//   index      BackupChunk records locating every chunk in pack
+//   gen.<n>    BackupManifest followed by the chunk hashes of generation n
+//   HEAD       number of generations
+class BackupStore
+{
+    std::string mDir;
+
+    std::string path(const std::string &name) const { return mDir + "/" + name; }
+
+    std::unordered_map<BackupHash, BackupChunk, BackupHashHasher> readIndex() const
+    {
+        std::unordered_map<BackupHash, BackupChunk, BackupHashHasher> index;
+        FileView file(path("index").c_str());
+        std::string_view buf = file.view();
+        for(size_t i = 0; i + sizeof(BackupChunk) <= buf.size(); i += sizeof(BackupChunk))
+        {
+            BackupChunk c;
+            memcpy(&c, buf.data() + i, sizeof(c));
+            index.emplace(c.hash, c);
+        }
+        return index;
+    }
+
+    bool readManifest(size_t gen, BackupManifest &m, std::vector<BackupHash> &hashes) const
+    {
+        FileView file(path("gen." + std::to_string(gen)).c_str());
+        std::string_view buf = file.view();
+        if(buf.size() < sizeof(m)) return false;
+        memcpy(&m, buf.data(), sizeof(m));
+        if(memcmp(m.magic, backup_magic, sizeof(backup_magic)) != 0
+            || buf.size() != sizeof(m) + m.chunks * sizeof(BackupHash)) return false;
+        hashes.resize(m.chunks);
+        memcpy(hashes.data(), buf.data() + sizeof(m), m.chunks * sizeof(BackupHash));
+        return true;
+    }
+
+public:
+    explicit BackupStore(std::string dir) : mDir(std::move(dir)) {}
+
+    size_t generations() const
+    {
+        size_t n = 0;
+        std::ifstream(path("HEAD")) >> n;
+        return n;
+    }
+
+    // adds content as the next generation and sets gen to its number. returns
+    // false if it could not be written in full, the generation is then not counted.
+    bool store(std::string_view content, size_t *gen = nullptr)
+    {
+        mkdir(mDir.c_str(), 0755);
+        auto index = readIndex();
+        int pack = ::open(path("pack").c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        int idx = ::open(path("index").c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        struct stat st;
+        if(pack < 0 || idx < 0 || fstat(pack, &st) != 0)
+        {
+            std::cerr << "cannot open backup store '" << mDir << "'." << std::endl;
+            if(pack >= 0) ::close(pack);
+            if(idx >= 0) ::close(idx);
+            return false;
+        }
+        uint64_t pack_size = st.st_size;
+        std::vector<BackupHash> hashes;
+        bool ok = true;
+        // cut after a record whose hash matches a bit pattern, so boundaries
+        // follow the content and an edit only disturbs the chunk around it
+        size_t begin = 0, record = 0;
+        while(ok && begin < content.size())
+        {
+            size_t end = content.find(']', record);
+            end = (end == std::string_view::npos) ? content.size() : end + 1;
+            if(end < content.size() && content[end] == '\n') ++end;
+            bool cut = end == content.size() || end - begin >= (1 << 20)
+                || (hashBytes(content.substr(record, end - record)).a & 63) == 0;
+            record = end;
+            if(!cut) continue;
+            std::string_view chunk = content.substr(begin, end - begin);
+            BackupHash h = hashBytes(chunk);
+            hashes.push_back(h);
+            begin = end;
+            if(index.count(h)) continue;
+            BackupChunk c{h, pack_size, chunk.size()};
+            ok = write(pack, chunk.data(), chunk.size()) == ssize_t(chunk.size())
+                && write(idx, &c, sizeof(c)) == ssize_t(sizeof(c));
+            pack_size += chunk.size();
+            index.emplace(h, c);
+        }
+        ok = ok && fdatasync(pack) == 0 && fdatasync(idx) == 0;
+        ::close(pack);
+        ::close(idx);
+
+        size_t next = generations();
+        BackupManifest m;
+        memcpy(m.magic, backup_magic, sizeof(backup_magic));
+        m.time = time(nullptr);
+        m.size = content.size();
+        m.chunks = hashes.size();
+        std::ofstream manifest(path("gen." + std::to_string(next)), std::ios_base::binary | std::ios_base::trunc);
+        manifest.write(reinterpret_cast<const char*>(&m), sizeof(m));
+        manifest.write(reinterpret_cast<const char*>(hashes.data()), hashes.size() * sizeof(BackupHash));
+        manifest.close();
+        // HEAD only counts the generation once everything it references is written
+        std::ofstream head(path("HEAD.tmp"), std::ios_base::trunc);
+        head << next + 1 << std::endl;
+        head.close();
+        if(!ok || !manifest || !head || rename(path("HEAD.tmp").c_str(), path("HEAD").c_str()) != 0)
+        {
+            std::cerr << "failed to write backup generation " << next << "." << std::endl;
+            return false;
+        }
+        if(gen) *gen = next;
+        return true;
+    }
+
+    // reassembles the content of a generation
+    bool load(size_t gen, std::string &content) const
+    {
+        BackupManifest m;
+        std::vector<BackupHash> hashes;
+        if(gen >= generations() || !readManifest(gen, m, hashes))
+        {
+            std::cerr << "no backup generation " << gen << "." << std::endl;
+            return false;
+        }
+        auto index = readIndex();
+        FileView pack(path("pack").c_str(), false);
+        std::string_view buf = pack.view();
+        content.clear();
+        content.reserve(m.size);
+        for(auto &h : hashes)
+        {
+            auto i = index.find(h);
+            if(i == index.end() || i->second.offset + i->second.size > buf.size())
+            {
+                std::cerr << "backup generation " << gen << " references a missing chunk." << std::endl;
+                return false;
+            }
+            content.append(buf.substr(i->second.offset, i->second.size));
+        }
+        return true;
+    }
+
+    void list(std::ostream &s) const
+    {
+        size_t n = generations();
+        for(size_t gen = 0; gen < n; ++gen)
+        {
+            BackupManifest m;
+            std::vector<BackupHash> hashes;
+            if(!readManifest(gen, m, hashes))
+            {
+                s << gen << "\t<damaged>\n";
+                continue;
+            }
+            char date[64];
+            time_t t = m.time;
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&t));
+            s << gen << "\t" << date << "\t" << m.size << " bytes\t" << m.chunks << " chunks\n";
+        }
+        struct stat st;
+        if(stat(path("pack").c_str(), &st) == 0) s << "store size: " << st.st_size << " bytes" << std::endl;
+    }
+};
+
+// reads a generation number given on the command line
+bool parseGeneration(const std::string &arg, size_t &gen)
+{
+    char *end;
+    errno = 0;
+    gen = strtoul(arg.c_str(), &end, 10);
+    if(arg.empty() || !isdigit(static_cast<unsigned char>(arg[0])) || *end || errno)
+    {
+        std::cerr << "'" << arg << "' is not a backup generation." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// prints the head words added (+), removed (-) and changed (~) from a to b
+void diffDictionaries(std::string_view a, std::string_view b, std::ostream &s)
+{
+    std::map<std::string, Word> ma, mb;
+    parseWords(a, 0, ma);
+    parseWords(b, 0, mb);
+    auto i = ma.begin();
+    auto j = mb.begin();
+    std::ostringstream ta, tb;
+    while(i != ma.end() || j != mb.end())
+    {
+        if(j == mb.end() || (i != ma.end() && i->first < j->first))
+        {
+            s << "- " << (i++)->first << "\n";
+        }
+        else if(i == ma.end() || j->first < i->first)
+        {
+            s << "+ " << (j++)->first << "\n";
+        }
+        else
+        {
+            ta.str(""); tb.str("");
+            ta << i->second;
+            tb << j->second;
+            if(ta.str() != tb.str()) s << "~ " << i->first << "\n";
+            ++i, ++j;
+        }
+    }
+    s.flush();
+}
+
+// reads the records of a dict file in order, a block at a time, so a pass
+// over a file takes memory bounded by the block size and the largest
+// record. positions handed out are in buffer(), which moves along the file.
+class RecordReader
+{
+    int                 mFd;
+    std::string         mBuffer;
+    uint64_t            mOffset = 0;        // of mBuffer in the file
+    size_t              mPos = 0;           // parsed up to here
+    size_t              mLimit = 0;         // whole records up to here
+    size_t              mSize = 0;          // read up to here
+    size_t              mUnclosed = std::string_view::npos;
+    bool                mEof = false, mFailed = false;
+    uint64_t            mCounted = 0;       // lines are counted up to this offset
+    uint64_t            mLine = 1;          // line of mCounted
+    uint64_t            mLineStart = 0;     // offset where it begins
+
+    // moves the line count to file offset pos, which never goes backwards
+    void                locate(uint64_t pos)
+    {
+        if(pos <= mCounted) return;
+        const char *b = mBuffer.data() + (mCounted - mOffset), *e = mBuffer.data() + (pos - mOffset);
+        if(size_t n = std::count(b, e, '\n'))
+        {
+            mLine += n;
+            mLineStart = mOffset + (static_cast<const char*>(memrchr(b, '\n', e - b)) - mBuffer.data()) + 1;
+        }
+        mCounted = pos;
+    }
+
+    // keeps what is not parsed yet and reads another block, growing the
+    // buffer while it does not hold a whole record
+    void                fill()
+    {
+        locate(mOffset + mPos);
+        memmove(&mBuffer[0], mBuffer.data() + mPos, mSize - mPos);
+        mOffset += mPos;
+        mSize -= mPos;
+        mPos = 0;
+        if(mSize == mBuffer.size()) mBuffer.resize(mBuffer.size() * 2);
+        ssize_t n;
+        while((n = read(mFd, &mBuffer[mSize], mBuffer.size() - mSize)) < 0 && errno == EINTR);
+        if(n < 0) mFailed = true;
+        if(n <= 0) mEof = true;
+        else mSize += n;
+        // have the kernel read the next block while this one is parsed
+        if(!mEof) posix_fadvise(mFd, mOffset + mSize, mBuffer.size(), POSIX_FADV_WILLNEED);
+        // ']' ends a block in every parser state, so parsing up to the
+        // last one never stops inside a record
+        mLimit = mSize;
+        if(!mEof)
+        {
+            auto last = static_cast<const char*>(memrchr(mBuffer.data(), ']', mSize));
+            mLimit = last ? last - mBuffer.data() + 1 : 0;
+        }
+    }
+
+public:
+    explicit RecordReader(const char *path, size_t block = 1 << 20) : mFd(open(path, O_RDONLY)), mBuffer(block, '\0')
+    {
+        if(mFd >= 0) posix_fadvise(mFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    ~RecordReader() { if(mFd >= 0) ::close(mFd); }
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    bool                good() const { return mFd >= 0 && !mFailed; }
+    std::string_view    buffer() const { return std::string_view(mBuffer.data(), mSize); }
+
+    // parses the next record into r like parseWord does. returns parse_end
+    // at the end of the file, dropping a record left open there.
+    template<class Record>
+    parse_result        next(Record &r)
+    {
+        if(mFd < 0) return parse_end;
+        for(;;)
+        {
+            size_t begin = mPos;
+            parse_result result = parseWord(std::string_view(mBuffer.data(), mLimit), mPos, r);
+            if(result != parse_end) return result;
+            if(mEof)
+            {
+                while(begin < mLimit && isspace(uint8_t(mBuffer[begin]))) ++begin;
+                if(begin < mLimit) mUnclosed = begin;
+                mPos = mLimit;
+                return parse_end;
+            }
+            mPos = mLimit;
+            fill();
+        }
+    }
+
+    // moves past the bytes up to the next block; parseWord would fail on
+    // each of them
+    void                skipToBlock() { mPos = std::min(std::string_view(mBuffer.data(), mLimit).find('[', mPos), mLimit); }
+
+    // where a record left open at the end of the file begins, npos if none
+    size_t              unclosed() const { return mUnclosed; }
+
+    // line and column of pos, which must not go backwards
+    std::pair<uint64_t, uint64_t> location(size_t pos)
+    {
+        locate(mOffset + pos);
+        return std::make_pair(mLine, mOffset + pos - mLineStart + 1);
+    }
+};
+
+// reads a dict file in blocks and reports every parser diagnostic with its
+// line and column, head words given more than once, and the head words that
+// break the sorted order. memory is bounded by the block size and the
+// largest record, plus 16 bytes per distinct head word to spot duplicates.
+// with a repair stream, every record is also written there as the loader
+// would read it, adjacent duplicates merged.
+class DictChecker : public ParseListener
+{
+    // what parseWord fills in: only the head word is kept, items are
+    // checked, and copied into a Word when repairing
+    struct Record
+    {
+        DictChecker        &checker;
+        std::string_view    word;
+        Word               *repair;
+        std::pair<uint64_t, uint64_t> at{0, 0}; // line and column of word, once located
+
+        // takes the location of the head word while the reader's forward
+        // only cursor has not passed it, before any item is reported
+        void                locate()
+        {
+            if(at.first == 0 && !word.empty()) at = checker.mReader.location(word.data() - checker.mReader.buffer().data());
+        }
+
+        void                addItem(std::string_view title, std::string_view content)
+        {
+            // issues raised by item checks are reported at the item title
+            checker.mItem = title.data() - checker.mReader.buffer().data();
+            if(repair) repair->addItem(title, content);
+            else if(title == "defi") splitDefinition(content);
+            else if(title != "coll" && title != "exam" && title != "cate") parseIssue(pi_unknown_item);
+        }
+    };
+
+    const char             *mPath;
+    std::ostream           &mOut;
+    RecordReader            mReader;
+    size_t                  mItem = 0;          // in the buffer, of the item being added
+    Record                 *mRecord = nullptr;  // being parsed
+    parse_issue             mLast = parse_issue_count;
+    std::vector<std::pair<uint64_t, uint64_t>> mSeen;   // head word hash and line, open addressing
+    size_t                  mSeenCount = 0;
+    // while the file is sorted a head word can only repeat the one before
+    // it, the others are only listed and hashed into mSeen once it is not
+    std::vector<std::pair<uint64_t, uint64_t>> mSorted;
+    bool                    mOrdered = true;
+    std::string             mPrevious;          // last head word
+    uint64_t                mPreviousLine = 0;  // where it first appeared
+    size_t                  mRecords = 0, mErrors = 0, mWarnings = 0, mDuplicates = 0, mUnordered = 0;
+
+    // prints "path:line:column: " for a line and column
+    std::ostream&           at(std::pair<uint64_t, uint64_t> l)
+    {
+        return mOut << mPath << ":" << l.first << ":" << l.second << ": ";
+    }
+
+    // the same for a position in the buffer
+    std::ostream&           at(size_t pos) { return at(mReader.location(pos)); }
+
+    // line of the head word with hash h if it was seen before, otherwise
+    // remembers it at line and returns 0
+    uint64_t                seen(uint64_t h, uint64_t line)
+    {
+        if(mSeenCount * 2 >= mSeen.size())
+        {
+            std::vector<std::pair<uint64_t, uint64_t>> old(std::max<size_t>(1024, mSeen.size() * 2));
+            old.swap(mSeen);
+            mSeenCount = 0;
+            for(auto &e : old) if(e.second) seen(e.first, e.second);
+        }
+        for(size_t k = h & (mSeen.size() - 1);; k = (k + 1) & (mSeen.size() - 1))
+        {
+            if(mSeen[k].second == 0)
+            {
+                mSeen[k] = {h, line};
+                ++mSeenCount;
+                return 0;
+            }
+            if(mSeen[k].first == h) return mSeen[k].second;
+        }
+    }
+
+    // checks a head word read at location l against those before it
+    void                    headWord(std::string_view w, std::pair<uint64_t, uint64_t> l)
+    {
+        ++mRecords;
+        uint64_t line = l.first;
+        uint64_t h = std::hash<std::string_view>()(w), first = 0;
+        if(!mPrevious.empty() && w < mPrevious)
+        {
+            ++mUnordered;
+            if(mOrdered)
+            {
+                for(auto &e : mSorted) seen(e.first, e.second);
+                std::vector<std::pair<uint64_t, uint64_t>>().swap(mSorted);
+                mOrdered = false;
+            }
+        }
+        if(!mOrdered) first = seen(h, line);
+        else if(w == mPrevious) first = mPreviousLine;
+        else mSorted.emplace_back(h, line);
+        if(first)
+        {
+            at(l) << "warning: head word '" << w << "' is also at line " << first << ", merged on load.\n";
+            ++mDuplicates;
+        }
+        if(w != mPrevious) mPreviousLine = first ? first : line;
+        mPrevious = w;
+    }
+
+public:
+    DictChecker(const char *path, std::ostream &out) : mPath(path), mOut(out), mReader(path) {}
+
+    void                    issue(parse_issue i, size_t pos) override
+    {
+        if(mRecord) mRecord->locate();
+        mLast = i;
+        bool warning = i >= pi_blank_content;
+        std::string_view message = parse_issue_messages[i];
+        if(message.substr(0, 9) == "warning: ") message.remove_prefix(9);
+        at(pos == std::string_view::npos ? mItem : pos) << (warning ? "warning: " : "error: ") << message << "\n";
+        ++(warning ? mWarnings : mErrors);
+    }
+
+    // checks the whole file, repairing it into repair if given. returns
+    // false if the file has errors or cannot be read.
+    bool                    run(std::ostream *repair)
+    {
+        if(!mReader.good())
+        {
+            std::cerr << "cannot open '" << mPath << "'." << std::endl;
+            return false;
+        }
+        ParseListener *outer = parse_listener;
+        parse_listener = this;
+        Word word, pending;
+        for(;;)
+        {
+            Record r{*this, std::string_view(), repair ? &word : nullptr};
+            mLast = parse_issue_count;
+            mRecord = &r;
+            parse_result result = mReader.next(r);
+            mRecord = nullptr;
+            if(result == parse_end) break;
+            // the loader fails on every byte up to the next block, once is enough
+            if(mLast == pi_expected_block) mReader.skipToBlock();
+            if(r.word.empty()) continue;
+            r.locate();
+            headWord(r.word, r.at);
+            if(!repair) continue;
+            word.word = r.word;
+            if(word.word == pending.word)
+            {
+                pending.merge(word);
+            }
+            else
+            {
+                if(!pending.word.empty()) *repair << pending;
+                pending = std::move(word);
+            }
+            word = Word();
+        }
+        parse_listener = outer;
+        if(mReader.unclosed() != std::string_view::npos)
+        {
+            at(mReader.unclosed()) << "error: record not closed before the end of the file.\n";
+            ++mErrors;
+        }
+        if(repair && !pending.word.empty()) *repair << pending;
+        if(!mReader.good()) std::cerr << "cannot read '" << mPath << "'." << std::endl;
+        mOut << mPath << ": " << mRecords << " records, " << mErrors << " errors, " << mWarnings << " warnings, "
+             << mDuplicates << " duplicated head words, " << mUnordered << " out of order." << std::endl;
+        return mReader.good() && mErrors == 0;
+    }
+};
+
+// output stream buffer handing full blocks to a thread that writes them to
+// a file descriptor, so filling the next block overlaps writing the last
+class WriterBuffer : public std::streambuf
+{
+    int                     mFd;
+    std::vector<char>       mBlocks[2];
+    int                     mFilling = 0;       // block being filled, the other one may be queued
+    size_t                  mQueued = 0;        // bytes of the other block left to write
+    bool                    mStop = false, mFailed = false;
+    std::mutex              mLock;
+    std::condition_variable mChanged;
+    std::thread             mWriter;
+
+    void                    writer()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        for(;;)
+        {
+            mChanged.wait(lock, [&] { return mQueued || mStop; });
+            if(!mQueued) return;
+            const char *p = mBlocks[1 - mFilling].data();
+            size_t n = mQueued;
+            lock.unlock();
+            bool failed = false;
+            while(n > 0)
+            {
+                ssize_t w = ::write(mFd, p, n);
+                if(w < 0 && errno == EINTR) continue;
+                if(w <= 0)
+                {
+                    failed = true;
+                    break;
+                }
+                p += w;
+                n -= w;
+            }
+            lock.lock();
+            mFailed = mFailed || failed;
+            mQueued = 0;
+            mChanged.notify_all();
+        }
+    }
+
+    // queues the filled block once the writer is done with the other one
+    bool                    handOver(bool wait)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mChanged.wait(lock, [&] { return !mQueued; });
+        if(pptr() > pbase())
+        {
+            mQueued = pptr() - pbase();
+            mFilling = 1 - mFilling;
+            mChanged.notify_all();
+        }
+        setp(mBlocks[mFilling].data(), mBlocks[mFilling].data() + mBlocks[mFilling].size());
+        if(wait) mChanged.wait(lock, [&] { return !mQueued; });
+        return !mFailed;
+    }
+
+protected:
+    int_type                overflow(int_type c) override
+    {
+        if(!handOver(false)) return traits_type::eof();
+        if(c != traits_type::eof())
+        {
+            *pptr() = c;
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int                     sync() override { return handOver(true) ? 0 : -1; }
+
+public:
+    explicit WriterBuffer(int fd, size_t size = 1 << 20) : mFd(fd)
+    {
+        mBlocks[0].resize(size);
+        mBlocks[1].resize(size);
+        setp(mBlocks[0].data(), mBlocks[0].data() + size);
+        mWriter = std::thread([this] { writer(); });
+    }
+    ~WriterBuffer()
+    {
+        sync();
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mStop = true;
+            mChanged.notify_all();
+        }
+        mWriter.join();
+    }
+};
+
+// rough heap footprint of a word held in std::map<std::string, Word>
+size_t wordFootprint(const Word &w)
+{
+    size_t bytes = 96 + sizeof(Word) + w.word.size();
+    for(auto &d : w.defi) bytes += 80 + d.second.size();
+    for(auto *items : {&w.coll, &w.exam, &w.cate})
+        for(auto &i : *items) bytes += 64 + i.size();
+    return bytes;
+}
+
+// merges dict files into one sorted file at out, folding the records of a
+// head word together like Word::merge does, in input order. inputs are read
+// into sorted runs of about memory bytes, written to files next to out when
+// they do not all fit, and the runs are then merged at once reading one
+// record of each at a time. returns false if a file could not be read or
+// written.
+bool mergeDictionaries(const std::vector<std::string> &inputs, const std::string &out, size_t memory)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::string tmp = out + ".tmp";
+    std::vector<std::string> runs;
+    // writes words, in order, to path through a writer thread
+    auto writeFile = [](const std::string &path, auto &&produce) {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if(fd < 0)
+        {
+            std::cerr << "cannot open '" << path << "'." << std::endl;
+            return false;
+        }
+        bool good;
+        {
+            WriterBuffer buffer(fd);
+            std::ostream s(&buffer);
+            produce(s);
+            good = bool(s.flush());
+        }
+        if(::close(fd) != 0 || !good)
+        {
+            std::cerr << "cannot write '" << path << "'." << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    // run formation: each run is a sorted map written out once it is full
+    std::map<std::string, Word> run;
+    size_t held = 0, records = 0;
+    auto spill = [&] {
+        std::string path = out + ".run." + std::to_string(runs.size());
+        runs.push_back(path);
+        bool good = writeFile(path, [&](std::ostream &s) { for(auto &w : run) s << w.second; });
+        run.clear();
+        held = 0;
+        return good;
+    };
+    auto removeRuns = [&] { for(auto &r : runs) unlink(r.c_str()); };
+    for(auto &input : inputs)
+    {
+        RecordReader reader(input.c_str());
+        Word w;
+        while(reader.next(w) != parse_end)
+        {
+            ++records;
+            if(!w.word.empty())
+            {
+                held += wordFootprint(w);
+                storeWord(run, std::move(w));
+            }
+            w = Word();
+            if(held > memory && !spill())
+            {
+                removeRuns();
+                return false;
+            }
+        }
+        if(!reader.good())
+        {
+            std::cerr << "cannot read '" << input << "'." << std::endl;
+            removeRuns();
+            return false;
+        }
+    }
+
+    bool good;
+    size_t words = 0;
+    if(runs.empty())
+    {
+        // everything fit in one run, it is the result
+        words = run.size();
+        good = writeFile(tmp, [&](std::ostream &s) { for(auto &w : run) s << w.second; });
+    }
+    else
+    {
+        if(!run.empty() && !spill())
+        {
+            removeRuns();
+            return false;
+        }
+        // every run gets an equal share of memory to read through
+        size_t block = std::clamp<size_t>(memory / 2 / runs.size(), 1 << 16, 1 << 20);
+        std::vector<std::unique_ptr<RecordReader>> readers;
+        std::vector<Word> heads(runs.size());
+        // the run holding the smallest head word, earlier runs first on ties
+        auto later = [&](size_t a, size_t b) { return heads[a].word != heads[b].word ? heads[a].word > heads[b].word : a > b; };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(later)> queue(later);
+        auto advance = [&](size_t k) {
+            heads[k] = Word();
+            while(readers[k]->next(heads[k]) != parse_end)
+            {
+                if(!heads[k].word.empty())
+                {
+                    queue.push(k);
+                    return;
+                }
+                heads[k] = Word();
+            }
+        };
+        for(size_t k = 0; k < runs.size(); ++k)
+        {
+            readers.push_back(std::make_unique<RecordReader>(runs[k].c_str(), block));
+            advance(k);
+        }
+        good = writeFile(tmp, [&](std::ostream &s) {
+            while(!queue.empty())
+            {
+                size_t k = queue.top();
+                queue.pop();
+                Word w = std::move(heads[k]);
+                advance(k);
+                while(!queue.empty() && heads[queue.top()].word == w.word)
+                {
+                    size_t j = queue.top();
+                    queue.pop();
+                    w.merge(heads[j]);
+                    advance(j);
+                }
+                s << w;
+                ++words;
+            }
+        });
+        for(auto &r : readers) good = good && r->good();
+        removeRuns();
+    }
+    if(!good || rename(tmp.c_str(), out.c_str()) != 0)
+    {
+        std::cerr << "failed to write '" << out << "'." << std::endl;
+        unlink(tmp.c_str());
+        return false;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "merged " << records << " records of " << inputs.size() << " files into " << words << " words"
+              << " through " << std::max<size_t>(runs.size(), 1) << " run" << (runs.size() > 1 ? "s" : "")
+              << " in " << seconds << "s." << std::endl;
+    return true;
+}
+
+// rewrites dict only once the journal has grown past this share of it
+static const off_t journal_min_compaction = 1 << 20;
+static const off_t journal_compaction_ratio = 8;
+
+// how words parsed from dict text are held
+enum storage_mode
+{
+    storage_nodes,  // std::map<std::string, Word>
+    storage_arena,  // ArenaStore
+    storage_flat,   // FlatStore
+    storage_lazy    // LazyStore
+};
+
+// command line settings
+struct Options
+{
+    unsigned        jobs = std::max(1u, std::thread::hardware_concurrency());
+    storage_mode    storage = storage_nodes;
+    std::string     socket = "dict.sock";   // of serve and client
+    bool            stats = false;          // print timings and counters on exit
+    size_t          memory = size_t(256) << 20; // held by merge before it spills runs
+    unsigned        autosave = 300;         // seconds an edit may wait to be folded into dict, 0 for never
+};
+
+// an autosave moves the journal here while it folds the records into a new
+// dict, which is complete once it has this name
+static const char *const autosave_journal = "dict.journal.folding";
+static const char *const autosave_dict = "dict.folded";
+// a session with edits autosaves once it has had none for this long
+static const auto autosave_idle = std::chrono::seconds(30);
+
+// completes an autosave cut short: a new dict under its final name already
+// holds the records of the journal moved aside
+void finishAutosave()
+{
+    if(access(autosave_dict, F_OK) != 0) return;
+    unlink(autosave_journal);
+    if(rename(autosave_dict, "dict") != 0) std::cerr << "cannot move '" << autosave_dict << "' to dict." << std::endl;
+    syncDirectory("dict");
+}
+
+// a save writes the new dict here first, it then holds the records of both
+// journals, which are emptied before it takes the place of dict
+static const char *const saved_dict = "dict.saved";
+
+// completes a save cut short by emptying the journals the new dict already
+// holds and moving it in place. returns false if it could not be moved.
+bool finishSave()
+{
+    if(access(saved_dict, F_OK) != 0) return true;
+    int fd = ::open("dict.journal", O_WRONLY | O_TRUNC);
+    if(fd >= 0)
+    {
+        fsync(fd);
+        ::close(fd);
+    }
+    unlink(autosave_journal);
+    if(rename(saved_dict, "dict") != 0)
+    {
+        std::cerr << "cannot move '" << saved_dict << "' to dict." << std::endl;
+        return false;
+    }
+    syncDirectory("dict");
+    return true;
+}
+
+// loads dict, or its snapshot when that is fresh, and replays the journal
+// on top of it. returns true if the snapshot was used.
+bool openDictionary(Dictionary &dictionary, Journal *journal, const Options &options)
+{
+    finishAutosave();
+    finishSave();
+    Stopwatch watch;
+    // a snapshot newer than dict was written by the last compaction, skip parsing
+    bool use_snapshot = snapshotIsFresh("dict.snap", "dict") && dictionary.openSnapshot("dict.snap");
+    if(use_snapshot) stats.time(st_snapshot_open, watch.lap());
+    bool loaded = use_snapshot;
+    if(!loaded && options.storage == storage_lazy)
+    {
+        uint64_t faults = majorFaults();
+        watch.lap();
+        auto store = std::make_unique<LazyStore>("dict");
+        stats.time(st_load_io, watch.lap());
+        loaded = store->scan();
+        stats.time(st_load_parse, watch.lap());
+        stats.count(sc_load_faults, majorFaults() - faults);
+        if(loaded)
+        {
+            stats.count(sc_records, store->records());
+            dictionary.setBase(std::move(store));
+        }
+        else
+        {
+            std::cerr << "dict has a malformed block, parsing it in full." << std::endl;
+        }
+    }
+    // the stores parse like loadDictionary, timed the same way
+    auto load = [&](auto &store) {
+        uint64_t faults = majorFaults();
+        watch.lap();
+        FileView file("dict");
+        stats.time(st_load_io, watch.lap());
+        stats.count(sc_records, store->load(file.view()));
+        stats.time(st_load_parse, watch.lap());
+        stats.count(sc_load_faults, majorFaults() - faults);
+    };
+    if(!loaded && options.storage == storage_arena)
+    {
+        auto store = std::make_unique<ArenaStore>();
+        load(store);
+        store->report(std::cerr);
+        dictionary.setBase(std::move(store));
+    }
+    else if(!loaded && options.storage == storage_flat)
+    {
+        auto store = std::make_unique<FlatStore>();
+        load(store);
+        dictionary.setBase(std::move(store));
+    }
+    else if(!loaded)
+    {
+        loadDictionary("dict", dictionary.words(), options.jobs);
+    }
+    watch.lap();
+    // records an autosave did not get to fold come first
+    replayJournal(autosave_journal, dictionary);
+    off_t valid = replayJournal("dict.journal", dictionary);
+    stats.time(st_journal_replay, watch.lap());
+    if(journal) journal->open("dict.journal", valid);
+    return use_snapshot;
+}
+
+// stores dict in the backup store, writes the whole dictionary to a fresh one and refreshes
+// the snapshot if one is in use. the journals are emptied as the new dict goes in place,
+// see finishSave(). returns false when dict could not be replaced
+bool saveDictionary(const Dictionary &dictionary, bool snapshot)
+{
+    Stopwatch watch;
+    stats.count(sc_saves);
+    {
+        // dict is only replaced once it can be restored
+        FileView old("dict");
+        if(!old.view().empty() && !BackupStore("dict.backup").store(old.view()))
+        {
+            std::cerr << "failed to back up dict, not replacing it." << std::endl;
+            return false;
+        }
+    }
+    stats.time(st_save_backup, watch.lap());
+    int fd = open("dict.tmp", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    bool written = false;
+    if(fd >= 0)
+    {
+        {
+            FdBuffer buffer(fd);
+            std::ostream file(&buffer);
+            dictionary.write(file);
+            written = bool(file.flush());
+            uint64_t total = watch.lap();
+            stats.time(st_save_write, buffer.writeTime());
+            stats.time(st_save_serialize, total - buffer.writeTime());
+        }
+        // the buffer syncs on destruction, so fd outlives it
+        written = fsync(fd) == 0 && written;
+        written = ::close(fd) == 0 && written;
+    }
+    if(!written || rename("dict.tmp", saved_dict) != 0 || !syncDirectory(saved_dict))
+    {
+        std::cerr << "failed to write dict." << std::endl;
+        unlink("dict.tmp");
+        return false;
+    }
+    if(!finishSave()) return false;
+    // keep the snapshot in step so the next start can skip parsing
+    if(snapshot || access("dict.snap", F_OK) == 0)
+    {
+        watch.lap();
+        // a snapshot that could not be written in full must not replace the last good one
+        if(!writeSnapshot("dict.snap.tmp", dictionary) || rename("dict.snap.tmp", "dict.snap") != 0)
+        {
+            std::cerr << "failed to write snapshot, the next start parses dict." << std::endl;
+            unlink("dict.snap.tmp");
+        }
+        stats.time(st_save_snapshot, watch.lap());
+    }
+    return true;
+}
+
+// ends a session. edits are already in the journal, so dict is only
+// rewritten once the journal grows large
+void closeDictionary(const Dictionary &dictionary, Journal &journal, bool snapshot)
+{
+    struct stat st;
+    off_t dict_size = stat("dict", &st) == 0 ? st.st_size : 0;
+    if(journal.size() > std::max(journal_min_compaction, dict_size / journal_compaction_ratio)) saveDictionary(dictionary, snapshot);
+}
+
+// writes a dict file holding dict with the records of the journal at path
+// replayed on top, then puts it in place of dict and removes the journal.
+// dict is read a record at a time while its head words increase, as saves
+// write them; one that does not is loaded whole, merging duplicates like a
+// load does. the new file is complete once renamed to autosave_dict, which
+// finishAutosave() relies on after a crash. returns false if a file could
+// not be read or written.
+bool foldJournal(const char *path)
+{
+    // the records of every head word in order, a removal is an empty one
+    std::map<std::string, std::vector<std::optional<Word>>> edits;
+    {
+        FileView file(path);
+        readJournal(file.view(), [&](Word &delta) { edits[delta.word].emplace_back(std::move(delta)); },
+                    [&](const std::string &w) { edits[w].emplace_back(); });
+    }
+    // what replaying the records of a word leaves of its record r
+    auto replay = [](std::vector<std::optional<Word>> &records, std::optional<Word> &r) {
+        for(auto &delta : records)
+        {
+            if(!delta)
+            {
+                r.reset();
+                continue;
+            }
+            if(!r)
+            {
+                r.emplace();
+                r->word = delta->word;
+            }
+            r->merge(*delta);
+        }
+    };
+    {
+        FileView old("dict");
+        if(!old.view().empty() && !BackupStore("dict.backup").store(old.view()))
+        {
+            std::cerr << "autosave failed to back up dict, its edits stay in '" << path << "'." << std::endl;
+            return false;
+        }
+    }
+
+    std::string tmp = std::string(autosave_dict) + ".tmp";
+    // writes the words of dict, edited, to tmp; read(emit) hands them over
+    // in order and returns false if it cannot
+    auto write = [&](auto &&read) {
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if(fd < 0) return -1;
+        bool complete, good;
+        {
+            FdBuffer buffer(fd);
+            std::ostream out(&buffer);
+            auto pending = edits.begin();
+            complete = read([&](Word &w) {
+                // head words only in the journal come first
+                for(; pending != edits.end() && pending->first < w.word; ++pending)
+                {
+                    std::optional<Word> r;
+                    replay(pending->second, r);
+                    if(r) out << *r;
+                }
+                std::optional<Word> r(std::move(w));
+                if(pending != edits.end() && pending->first == r->word) replay((pending++)->second, r);
+                if(r) out << *r;
+            });
+            for(; complete && pending != edits.end(); ++pending)
+            {
+                std::optional<Word> r;
+                replay(pending->second, r);
+                if(r) out << *r;
+            }
+            good = bool(out.flush());
+        }
+        good = fsync(fd) == 0 && good;
+        good = ::close(fd) == 0 && good;
+        return good ? int(complete) : -1;
+    };
+    int written = write([](auto &&emit) {
+        RecordReader reader("dict");
+        std::string previous;
+        Word w;
+        for(; reader.next(w) != parse_end; w = Word())
+        {
+            if(w.word.empty()) continue;
+            if(w.word <= previous) return false;
+            previous = w.word;
+            emit(w);
+        }
+        return reader.good() || access("dict", F_OK) != 0;
+    });
+    if(written == 0)
+    {
+        written = write([](auto &&emit) {
+            std::map<std::string, Word> words;
+            FileView file("dict");
+            parseDictionary(file.view(), words);
+            for(auto &w : words) emit(w.second);
+            return true;
+        });
+    }
+    if(written != 1 || rename(tmp.c_str(), autosave_dict) != 0 || !syncDirectory(autosave_dict))
+    {
+        std::cerr << "autosave failed to write dict, its edits stay in '" << path << "'." << std::endl;
+        unlink(tmp.c_str());
+        return false;
+    }
+    finishAutosave();
+    // a snapshot older than dict is not used, rebuild it from the new dict
+    // so the next start still skips parsing
+    if(access("dict.snap", F_OK) == 0)
+    {
+        FlatStore flat;
+        {
+            FileView file("dict");
+            flat.load(file.view());
+        }
+        if(!flat.write("dict.snap.tmp") || rename("dict.snap.tmp", "dict.snap") != 0)
+        {
+            std::cerr << "autosave failed to write snapshot, the next start parses dict." << std::endl;
+            unlink("dict.snap.tmp");
+        }
+    }
+    return true;
+}
+
+// folds the journal into dict on a thread of its own while a session runs:
+// once no edit has come for autosave_idle, or period after the oldest edit
+// not saved yet. the session never waits for it, moving the journal aside
+// takes its lock for a rename, and the new dict is made from the files.
+class Autosaver
+{
+    Journal                    &mJournal;
+    std::chrono::seconds        mPeriod;
+    std::mutex                  mLock;
+    std::condition_variable     mWake;
+    bool                        mStop = false;
+    std::thread                 mThread;
+
+    void                        save()
+    {
+        Stopwatch watch;
+        // a journal left by a failed autosave is folded before new records
+        if(access(autosave_journal, F_OK) != 0)
+        {
+            if(!mJournal.rotate(autosave_journal)) return;
+            syncDirectory(autosave_journal);
+        }
+        if(!foldJournal(autosave_journal)) return;
+        stats.count(sc_autosaves);
+        stats.time(st_autosave, watch.lap());
+    }
+
+    void                        run()
+    {
+        // dict was parsed when the session began, its diagnostics were shown then
+        struct Quiet : ParseListener
+        {
+            void                issue(parse_issue, size_t) override {}
+        } quiet;
+        parse_listener = &quiet;
+        auto saved = std::chrono::steady_clock::now(), edited = saved;
+        off_t size = 0;
+        std::unique_lock<std::mutex> lock(mLock);
+        while(!mWake.wait_for(lock, std::chrono::seconds(1), [&] { return mStop; }))
+        {
+            auto now = std::chrono::steady_clock::now();
+            off_t s = mJournal.size();
+            if(s != size) edited = now;
+            size = s;
+            if(size == 0 && access(autosave_journal, F_OK) != 0) saved = now;
+            else if(now - edited >= autosave_idle || now - saved >= mPeriod)
+            {
+                lock.unlock();
+                save();
+                lock.lock();
+                saved = std::chrono::steady_clock::now();
+                size = mJournal.size();
+            }
+        }
+    }
+
+public:
+    Autosaver(Journal &journal, std::chrono::seconds period) : mJournal(journal), mPeriod(period)
+    {
+        mThread = std::thread([this] { run(); });
+    }
+
+    // waits for a save in progress
+    ~Autosaver()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mStop = true;
+        }
+        mWake.notify_all();
+        mThread.join();
+    }
+};
+
+struct termios original_state;
+
+void enableNoncanonicalInput()
+{
+    struct termios tattr;
+    tcgetattr(STDIN_FILENO, &tattr);
+    tattr.c_lflag &= ~(ICANON|ECHO); /* Clear ICANON and ECHO. */
+    tattr.c_cc[VMIN] = 1;
+    tattr.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &tattr);  
+}
+
+void disableNoncanonicalInput()
+{
+    tcsetattr(STDIN_FILENO, TCSANOW, &original_state);
+}
+
+void signalHandler(int /* signum */)
+{
+    std::cerr << "Received signal SIGINT, type '|' to exit, '~' to reset state.\n";
+}
+
+#ifdef VOC_BENCH
+// output stream that only counts what is written to it
+class CountingBuffer : public std::streambuf
+{
+    size_t mCount = 0;
+
+protected:
+    std::streamsize xsputn(const char*, std::streamsize n) override { mCount += n; return n; }
+    int_type        overflow(int_type c) override { ++mCount; return c; }
+
+public:
+    size_t          count() const { return mCount; }
+};
+
+// times exact lookup, prefix scan and full serialization on a dictionary
+// held as map/set nodes and as a FlatStore
+void benchLayouts(const char *path, std::ostream &out)
+{
+    typedef std::chrono::steady_clock clock;
+    auto seconds = [](clock::time_point since) { return std::chrono::duration<double>(clock::now() - since).count(); };
+    FileView file(path);
+    std::map<std::string, Word> nodes;
+    FlatStore flat;
+    auto t = clock::now();
+    parseWords(file.view(), 0, nodes);
+    double load_nodes = seconds(t);
+    t = clock::now();
+    flat.load(file.view());
+    double load_flat = seconds(t);
+
+    // look every word up in a shuffled order, then scan 2-letter prefixes of some
+    std::vector<std::string> keys;
+    for(auto &w : nodes) keys.push_back(w.first);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    std::vector<std::string> prefixes;
+    for(size_t i = 0; i < keys.size() && i < 10000; ++i) prefixes.push_back(keys[i].substr(0, 2));
+
+    size_t found = 0;
+    t = clock::now();
+    for(auto &k : keys) found += nodes.find(k) != nodes.end();
+    double lookup_nodes = seconds(t);
+    t = clock::now();
+    for(auto &k : keys) found += flat.find(k) != flat.size();
+    double lookup_flat = seconds(t);
+
+    size_t matched = 0;
+    t = clock::now();
+    for(auto &p : prefixes)
+        for(auto i = nodes.lower_bound(p); i != nodes.end() && i->first.compare(0, p.size(), p) == 0; ++i) ++matched;
+    double prefix_nodes = seconds(t);
+    t = clock::now();
+    for(auto &p : prefixes)
+        for(size_t i = flat.lowerBound(p); i < flat.size() && flat.word(i).substr(0, p.size()) == p; ++i) ++matched;
+    double prefix_flat = seconds(t);
+
+    CountingBuffer cb_nodes, cb_flat;
+    std::ostream s_nodes(&cb_nodes), s_flat(&cb_flat);
+    t = clock::now();
+    for(auto &w : nodes) s_nodes << w.second;
+    double save_nodes = seconds(t);
+    t = clock::now();
+    for(size_t i = 0; i < flat.size(); ++i) flat.writeWord(i, s_flat);
+    double save_flat = seconds(t);
+
+    out << nodes.size() << " words, " << found << " lookups, " << matched << " prefix matches\n"
+        << "                 nodes        flat\n"
+        << "load          " << std::setw(8) << load_nodes << "s   " << std::setw(8) << load_flat << "s\n"
+        << "lookup        " << std::setw(8) << lookup_nodes << "s   " << std::setw(8) << lookup_flat << "s\n"
+        << "prefix scan   " << std::setw(8) << prefix_nodes << "s   " << std::setw(8) << prefix_flat << "s\n"
+        << "serialize     " << std::setw(8) << save_nodes << "s   " << std::setw(8) << save_flat << "s\n"
+        << "flat layout   " << flat.bytes() << " bytes, serialized " << cb_nodes.count() << " / " << cb_flat.count() << " bytes" << std::endl;
+}
+
+// times printing every word of a dictionary to /dev/null token by token
+// through the color stream manipulators, and through Word::print, with and
+// without colors
+void benchRender(const char *path, std::ostream &out)
+{
+    typedef std::chrono::steady_clock clock;
+    auto seconds = [](clock::time_point since) { return std::chrono::duration<double>(clock::now() - since).count(); };
+    std::map<std::string, Word> words;
+    loadDictionary(path, words);
+
+    // how records were printed before Word::render
+    auto streamed = [](const Word &w, std::ostream &s) {
+        s << HEAD(w.word) << std::endl;
+        if(w.defi.empty()) s << "<no definitions>" << std::endl;
+        else { s << "[definitions]" << std::endl; for(auto &d : w.defi) s << CLAS(d.first) << ": " << DEFI(d.second) << std::endl; }
+        if(w.coll.empty()) s << "<no collocations>" << std::endl;
+        else { s << "[collocations]" << std::endl; for(auto &c : w.coll) s << COLL(c) << std::endl; }
+        if(w.exam.empty()) s << "<no examples>" << std::endl;
+        else { s << "[examples]" << std::endl; for(auto &e : w.exam) s << STCE(e) << std::endl; }
+        if(w.cate.empty()) s << "<uncategorized>" << std::endl;
+        else { s << "[categories]" << std::endl; for(auto &c : w.cate) s << CATE(c) << std::endl; }
+    };
+
+    bool colors = ConsoleColorModifier::enabled;
+    int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    double times[3];
+    for(int run = 0; run < 3; ++run)
+    {
+        ConsoleColorModifier::enabled = run < 2;
+        FdBuffer buffer(null);
+        std::ostream s(&buffer);
+        auto t = clock::now();
+        for(auto &w : words)
+        {
+            if(run == 0) streamed(w.second, s);
+            else w.second.print(s);
+        }
+        s.flush();
+        times[run] = seconds(t);
+    }
+    ConsoleColorModifier::enabled = colors;
+    close(null);
+
+    out << words.size() << " words\n"
+        << "streamed      " << std::setw(8) << times[0] << "s\n"
+        << "rendered      " << std::setw(8) << times[1] << "s\n"
+        << "plain         " << std::setw(8) << times[2] << "s" << std::endl;
+}
+#endif
+
+// most completions offered when a word is not found
+static const size_t suggestion_limit = 10;
+
+// lists the closest words starting with prefix, or if there are none the
+// words closest to it by spelling, returns them
+std::vector<std::string> suggestWords(Dictionary &dictionary, const std::string &prefix)
+{
+    size_t count = dictionary.countPrefixed(prefix);
+    if(count == 0)
+    {
+        // allow one typo in short words, two in longer ones
+        auto matches = dictionary.fuzzy(prefix, prefix.size() <= 4 ? 1 : 2, suggestion_limit);
+        for(auto &m : matches)
+        {
+            std::cerr << "did you mean '" << HEAD(m) << "'?\n";
+        }
+        return matches;
+    }
+    auto matches = dictionary.suggest(prefix, suggestion_limit);
+    for(auto &m : matches)
+    {
+        std::cerr << "are you finding '" << HEAD(m) << "'?\n";
+    }
+    if(count > matches.size())
+    {
+        std::cerr << "... and " << count - matches.size() << " more.\n";
+    }
+    return matches;
+}
+
+// most words listed for a text search
+static const size_t search_limit = 20;
+
+// prints the words with items matching query, and those items
+void searchText(Dictionary &dictionary, const std::string &query, std::ostream &s)
+{
+    Stopwatch watch;
+    TextQuery q(query);
+    auto found = dictionary.search(q);
+    if(found.empty())
+    {
+        stats.latency(sc_search, watch.lap());
+        std::cerr << "nothing matches '" << query << "'.\n";
+        return;
+    }
+    for(size_t i = 0; i < found.size() && i < search_limit; ++i)
+    {
+        Word *w = dictionary.find(found[i]);
+        if(w == nullptr) continue;
+        s << HEAD(w->word) << "\n";
+        for(auto &d : w->defi)
+            if(q.matches(tf_defi, d.second)) s << "  " << CLAS(d.first) << ": " << DEFI(d.second) << "\n";
+        for(auto &c : w->coll)
+            if(q.matches(tf_coll, c)) s << "  " << COLL(c) << "\n";
+        for(auto &e : w->exam)
+            if(q.matches(tf_exam, e)) s << "  " << STCE(e) << "\n";
+    }
+    s.flush();
+    stats.latency(sc_search, watch.lap());
+    if(found.size() > search_limit)
+    {
+        std::cerr << "... and " << found.size() - search_limit << " more.\n";
+    }
+}
+
+// prints the words whose categories satisfy query, as they are found.
+// returns false if query is malformed.
+bool listCategories(Dictionary &dictionary, const std::string &query, std::ostream &s)
+{
+    Stopwatch watch;
+    std::string error;
+    size_t n = dictionary.forEachInCategories(query, error, [&](std::string_view w) { s << HEAD(w) << "\n"; });
+    s.flush();
+    stats.latency(sc_category, watch.lap());
+    if(!error.empty()) std::cerr << "cannot read '" << query << "', " << error << ".\n";
+    else std::cerr << n << " word" << (n == 1 ? "" : "s") << " in '" << query << "'.\n";
+    return error.empty();
+}
+
+// what an add line is being read into
+enum vector_data_order : size_t
+{
+    vo_state,
+    vo_sentence,
+    vo_head_word,
+    vo_word_class,
+    vo_definition,
+    vo_collocation,
+    vo_category
+};
+
+enum add_state : char
+{
+    read_sentence,
+    read_head_word,
+    read_definition,
+    read_collocation,
+    read_category,
+    read_class,
+    bad_state
+};
+
+// reads one character of an add line into v, echoing what is accepted to
+// echo. returns true once the line is complete.
+// todo: this assumes that there are no errors in input
+bool readAddContent(std::vector<std::string> &v, char c, std::ostream &echo)
+{
+    if(v.empty())
+    {
+        v.reserve(7);
+        v.insert(v.end(), 7, std::string());
+        v[vo_state].push_back(read_sentence); // reading_state
+        v[vo_state].push_back(0); // inside_coll
+        v[vo_state].push_back(0); // coll_only
+    }
+    auto &as = v[vo_state][0];
+    char &inside_coll = v[vo_state][1];
+    char &coll_only = v[vo_state][2];
+    // todo: multiple categories, handle backspaces
+    switch(as)
+    {
+        case read_sentence:
+        {
+            if(c == ' ')
+            {
+                if(!v[vo_sentence].empty() && v[vo_sentence].back() != ' ')
+                {
+                    echo << c;
+                    v[vo_sentence].push_back(c);
+                }
+                break;
+            }
+            else if(c == '{')
+            {
+                echo << c;
+                inside_coll = true;
+                as = read_collocation;
+                break;
+            }
+            else if(c == '[')
+            {
+                echo << c;
+                as = read_head_word;
+                break;
+            }
+            else if(isprint(c))
+            {
+                echoKey(echo, FRONT_GREEN, c);
+                v[vo_sentence].push_back(c);
+                break;
+            }
+            break;
+        }
+        case read_head_word:
+        {
+            if(isalpha(c))
+            {
+                v[vo_sentence].push_back(c);
+                if(inside_coll) v[vo_collocation].push_back(c);
+                v[vo_head_word].push_back(c);
+                echoKey(echo, FRONT_CYAN, c);
+                break;
+            }
+            else if(c == '\'' && v[vo_head_word].empty())
+            {
+                as = read_category;
+                echo << c;
+                break;
+            }
+            else if(c == ':' && !v[vo_head_word].empty())
+            {
+                as = read_definition;
+                echo << c;
+                break;
+            }
+            else if(c == ']' && !v[vo_head_word].empty())
+            {
+                as = inside_coll ? read_collocation : read_sentence; // exit current state
+                echo << c;
+                break;
+            }
+            break;
+        }
+        case read_category:
+        {
+            if(isalpha(c))
+            {
+                v[vo_category].push_back(c);
+                echoKey(echo, FRONT_RED, c);
+                break;
+            }
+            else if(c == ',' && !v[vo_category].empty() && v[vo_category].back() != ',')
+            {
+                v[vo_category].push_back(c);
+                echo << c;
+                break;
+            }
+            else if(c == '\'' && !v[vo_category].empty())
+            {
+                as = read_head_word;
+                echo << c;
+                break;
+            }
+            break;
+        }
+        case read_definition:
+        {
+            if(c == '(')
+            {
+                as = read_class;
+                echo << c;
+                break;
+            }
+            else if(c == '.')
+            {
+                as = read_head_word;
+                echo << c;
+                break;
+            }
+            else if(isprint(c))
+            {
+                v[vo_definition].push_back(c);
+                echoKey(echo, FRONT_WHITE, c);
+                break;
+            }
+            break;
+        }
+        case read_collocation:
+        {
+            if(isalpha(c))
+            {
+                v[vo_collocation].push_back(c);
+                if(!coll_only) v[vo_sentence].push_back(c);
+                echoKey(echo, FRONT_MAGENTA, c);
+                break;
+            }
+            else if(c == ' ')
+            {
+                if(!v[vo_collocation].empty() && v[vo_collocation].back() != ' ')
+                {
+                    echo << c;
+                    v[vo_collocation].push_back(c);
+                    if(!coll_only) v[vo_sentence].push_back(c);
+                }
+                break;
+            }
+            else if(c == '[')
+            {
+                as = read_head_word;
+                echo << c;
+                break;
+            }
+            else if(c == '}')
+            {
+                inside_coll = false;
+                coll_only = false;
+                as = read_sentence;
+                echo << c;
+                break;
+            }
+            else if(c == ':' && !coll_only)
+            {
+                coll_only = true;
+                echo << c;
+                v[vo_collocation].push_back(c);
+            }
+            break;
+        }
+        case read_class:
+        {
+            if(isalpha(c))
+            {
+                v[vo_word_class].push_back(c);
+                echoKey(echo, FRONT_YELLOW, c);
+                break;
+            }
+            else if(c == ')')
+            {
+                as = read_definition;
+                echo << c;
+                break;
+            }
+            break;
+        }
+    }
+    if(c != '\n') return false;
+    echo << c;
+    return true;
+}
+
+// where and why an add line cannot be applied, the column counts from 1
+struct AnnotationError
+{
+    size_t          column = 0;
+    const char     *message = nullptr;
+};
+
+// why the add line read into v cannot be applied, nullptr if it can. a
+// collocation may hold the one ':' that separates its meaning, which
+// addAnnotation() turns into " - "; no other item may hold a character
+// that ends items in dict.
+const char *annotationProblem(const std::vector<std::string> &v)
+{
+    if(v.empty() || v[vo_head_word].empty()) return "no head word, mark one with [word]";
+    const std::string &coll = v[vo_collocation];
+    size_t sep = coll.find(':');
+    for(const std::string *item : {&v[vo_sentence], &v[vo_definition], &v[vo_collocation]})
+    {
+        for(size_t i = 0; i < item->size(); ++i)
+        {
+            char c = (*item)[i];
+            if((c == '$' || c == ':' || c == ']') && !(item == &coll && i == sep)) return "items cannot hold '$', ':' or ']'";
+        }
+    }
+    return nullptr;
+}
+
+// parses a whole add line, without its '+', into v the way readAddContent
+// leaves it once the line is typed. returns false with error filled if a
+// '[' or '{' is left open, no head word is marked, or an item would hold a
+// character that ends items in dict.
+bool parseAnnotation(std::string_view line, std::vector<std::string> &v, AnnotationError &error)
+{
+    thread_local std::ostream no_echo(nullptr);
+    v.clear();
+    size_t open = 0, items = 0;
+    for(size_t i = 0; i < line.size(); ++i)
+    {
+        char c = line[i];
+        bool outside = v.empty() || v[vo_state][0] == read_sentence;
+        bool coll_only = !v.empty() && v[vo_state][2];
+        readAddContent(v, c, no_echo);
+        if(outside && v[vo_state][0] != read_sentence) open = i;
+        size_t n = v[vo_sentence].size() + v[vo_definition].size() + v[vo_collocation].size();
+        // the ':' that starts a collocation's meaning is the separator
+        bool separator = c == ':' && !coll_only && v[vo_state][2];
+        if(n > items && !separator && (c == '$' || c == ':' || c == ']') && error.message == nullptr) error = {i + 1, "items cannot hold '$', ':' or ']'"};
+        items = n;
+    }
+    readAddContent(v, '\n', no_echo);
+    if(v[vo_state][0] != read_sentence) error = {open + 1, line[open] == '{' ? "'{' is not closed" : "'[' is not closed"};
+    else if(v[vo_head_word].empty() && error.message == nullptr) error = {1, "no head word, mark one with [word]"};
+    return error.message == nullptr;
+}
+
+// adds what a complete add line holds to the word it names. delta gets the
+// items that were not there yet. returns false if annotationProblem() finds
+// the line cannot be applied.
+bool addAnnotation(Dictionary &dictionary, std::vector<std::string> &v, Word &delta, std::ostream &out)
+{
+    if(annotationProblem(v)) return false;
+    auto &w = dictionary[v[vo_head_word]];
+    delta.word = v[vo_head_word];
+    if(w.word.empty())
+    {
+        w.word = v[vo_head_word];
+        out << "adding word '" << HEAD(v[vo_head_word]) << "'.\n";
+    }
+    else
+    {
+        out << "editing word '" << HEAD(v[vo_head_word]) << "'.\n";
+    }
+    if(!v[vo_definition].empty())
+    {
+        auto wcls = getWordClass(v[vo_word_class]);
+        auto lb = w.defi.lower_bound(wcls);
+        auto ub = w.defi.upper_bound(wcls);
+        bool dup = false;
+        for(; lb != ub; ++lb)
+        {
+            if(lb->second == v[vo_definition])
+            {
+                dup = true;
+                break;
+            }
+        }
+        if(!dup)
+        {
+            w.defi.insert(std::make_pair(wcls, v[vo_definition]));
+            delta.defi.insert(std::make_pair(wcls, v[vo_definition]));
+            out << "definition added: (" << CLAS(wcls) << ")" << DEFI(v[vo_definition]) << '\n';
+        }
+    }
+    // "phrase:meaning" is kept as "phrase - meaning", ':' would end the item in dict
+    size_t sep = std::min(v[vo_collocation].find(':'), v[vo_collocation].size());
+    std::string phrase = v[vo_collocation].substr(0, sep);
+    while(!phrase.empty() && phrase.back() == ' ') phrase.pop_back();
+    if(!v[vo_collocation].empty())
+    {
+        size_t meaning = v[vo_collocation].find_first_not_of(' ', sep + 1);
+        std::string coll = meaning == std::string::npos ? phrase : phrase + " - " + v[vo_collocation].substr(meaning);
+        while(!coll.empty() && coll.back() == ' ') coll.pop_back();
+        w.coll.insert(coll);
+        delta.coll.insert(coll);
+        out << "collocation added: " << COLL(coll) << '\n';
+    }
+    if(!v[vo_category].empty())
+    {
+        std::vector<std::string> scs;
+        scs.emplace_back();
+        for(auto i = v[vo_category].begin(); i != v[vo_category].end(); ++i)
+        {
+            if(*i == ',') scs.emplace_back();
+            else scs.back().push_back(*i);
+        }
+        for(auto &sc : scs)
+        {
+            if(sc.empty()) continue;
+            w.cate.insert(sc);
+            delta.cate.insert(sc);
+            out << "category added: " << CATE(sc) << '\n';
+        }
+    }
+    if(!v[vo_sentence].empty() && v[vo_sentence] != v[vo_collocation].substr(0, sep) && v[vo_sentence] != phrase && v[vo_sentence] != v[vo_head_word])
+    {
+        w.exam.insert(v[vo_sentence]);
+        delta.exam.insert(v[vo_sentence]);
+        out << "example added: " << STCE(v[vo_sentence]) << '\n';
+    }
+    return true;
+}
+
+// adds what a complete add line holds to the word it names, and records it
+// in the journal
+void applyAddContent(Dictionary &dictionary, Journal &journal, std::vector<std::string> &v, std::ostream &out)
+{
+    Word delta; // what this line adds, for the journal
+    if(const char *problem = annotationProblem(v))
+    {
+        std::cerr << "add line not applied: " << problem << ".\n";
+        return;
+    }
+    addAnnotation(dictionary, v, delta, out);
+    journal.add(delta);
+    dictionary.itemsAdded(delta);
+}
+
+// answers lookups and add lines read from fd, one per line, without echo or
+// terminal handling. results go to out, a summary to std::cerr.
+void runBatch(Dictionary &dictionary, Journal &journal, int fd, std::ostream &out)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t lookups = 0, adds = 0;
+    auto query = [&](std::string_view line) {
+        while(!line.empty() && isspace(uint8_t(line.back()))) line.remove_suffix(1);
+        while(!line.empty() && isspace(uint8_t(line.front()))) line.remove_prefix(1);
+        if(line.empty()) return;
+        if(line[0] == '+')
+        {
+            Stopwatch watch;
+            std::vector<std::string> v;
+            AnnotationError error;
+            if(parseAnnotation(line.substr(1), v, error)) applyAddContent(dictionary, journal, v, out);
+            else out << "add line not applied, column " << error.column << ": " << error.message << ".\n";
+            stats.latency(sc_add, watch.lap());
+            ++adds;
+            return;
+        }
+        ++lookups;
+        Stopwatch watch;
+        if(Word *w = dictionary.find(std::string(line))) w->print(out);
+        else out << "word '" << HEAD(line) << "' not found.\n";
+        stats.latency(sc_lookup, watch.lap());
+    };
+
+    std::string pending;
+    char block[1 << 16];
+    for(;;)
+    {
+        ssize_t n = read(fd, block, sizeof(block));
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) break;
+        pending.append(block, n);
+        size_t begin = 0;
+        for(size_t end; (end = pending.find('\n', begin)) != std::string::npos; begin = end + 1)
+            query(std::string_view(pending).substr(begin, end - begin));
+        pending.erase(0, begin);
+    }
+    query(pending);
+    out.flush();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << lookups << " lookups, " << adds << " adds in " << seconds << "s";
+    if(seconds > 0) std::cerr << " (" << size_t((lookups + adds) / seconds) << " lines/s)";
+    std::cerr << std::endl;
+}
+
+// adds the annotated sentences of a file to dictionary, one per line like
+// add lines, the '+' optional. the file is cut into a chunk per thread at
+// line breaks and the chunks are parsed in parallel. lines with errors are
+// reported as path:line:column and skipped, the others are applied in file
+// order and their new items journaled together with one write. returns
+// false if the file could not be read or a line was skipped.
+bool ingestAnnotations(Dictionary &dictionary, Journal &journal, const char *path, unsigned jobs)
+{
+    auto start = std::chrono::steady_clock::now();
+    FileView file(path);
+    std::string_view buf = file.view();
+    if(buf.empty())
+    {
+        std::cerr << "nothing to ingest from '" << path << "'." << std::endl;
+        return false;
+    }
+    std::vector<size_t> bounds{0};
+    for(unsigned k = 1; k < jobs; ++k)
+    {
+        size_t p = buf.find('\n', std::max(bounds.back(), buf.size() / jobs * k));
+        if(p == std::string_view::npos) break;
+        if(p + 1 > bounds.back()) bounds.push_back(p + 1);
+    }
+    if(bounds.back() != buf.size()) bounds.push_back(buf.size());
+
+    struct Chunk
+    {
+        std::vector<std::vector<std::string>>           lines;
+        std::vector<std::pair<size_t, AnnotationError>> errors; // line in the chunk, from 0
+        size_t                                          count = 0; // lines in the chunk
+    };
+    std::vector<Chunk> chunks(bounds.size() - 1);
+    auto parse = [&](size_t k) {
+        Chunk &chunk = chunks[k];
+        std::string_view text = buf.substr(bounds[k], bounds[k + 1] - bounds[k]);
+        for(size_t pos = 0; pos < text.size(); ++chunk.count)
+        {
+            size_t end = std::min(text.find('\n', pos), text.size());
+            std::string_view line = text.substr(pos, end - pos);
+            pos = end + 1;
+            size_t skipped = 0;
+            while(skipped < line.size() && isspace(uint8_t(line[skipped]))) ++skipped;
+            if(skipped < line.size() && line[skipped] == '+') ++skipped;
+            if(line.find_first_not_of(" \t\r", skipped) == std::string_view::npos) continue;
+            AnnotationError error;
+            chunk.lines.emplace_back();
+            if(parseAnnotation(line.substr(skipped), chunk.lines.back(), error)) continue;
+            chunk.lines.pop_back();
+            error.column += skipped;
+            chunk.errors.emplace_back(chunk.count, error);
+        }
+    };
+    std::vector<std::thread> pool;
+    for(size_t k = 1; k < chunks.size(); ++k) pool.emplace_back(parse, k);
+    parse(0);
+    for(auto &t : pool) t.join();
+    double parsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // deltas of a word are folded into one journal record
+    std::map<std::string, Word> deltas;
+    std::ostream quiet(nullptr);
+    size_t lines = 0, applied = 0, skipped = 0;
+    for(auto &chunk : chunks)
+    {
+        for(auto &e : chunk.errors)
+        {
+            std::cerr << path << ":" << lines + e.first + 1 << ":" << e.second.column << ": error: " << e.second.message << "." << std::endl;
+        }
+        for(auto &v : chunk.lines)
+        {
+            Word delta;
+            if(!addAnnotation(dictionary, v, delta, quiet)) continue;
+            dictionary.itemsAdded(delta);
+            Word &d = deltas[delta.word];
+            if(d.word.empty()) d = std::move(delta);
+            else d.merge(delta);
+        }
+        lines += chunk.count;
+        applied += chunk.lines.size();
+        skipped += chunk.errors.size();
+    }
+    journal.add(deltas);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "ingested " << applied << " lines into " << deltas.size() << " words in " << seconds << "s (parsing "
+              << parsed << "s, " << size_t(applied / std::max(seconds, 1e-9)) << " lines/s)";
+    if(skipped) std::cerr << ", " << skipped << " lines with errors skipped";
+    std::cerr << "." << std::endl;
+    return skipped == 0;
+}
+
+// delimited word lists read by import
+enum import_format
+{
+    import_tsv,     // fields split by tabs, no quoting
+    import_csv      // fields split by commas, "..." quoting with "" inside
+};
+
+// what a column of an imported row holds
+enum import_column : uint8_t
+{
+    ic_word,
+    ic_class,
+    ic_definition,
+    ic_example,
+    ic_category,
+    ic_collocation,
+    ic_ignored
+};
+
+struct ImportColumnName
+{
+    std::string_view    name;
+    import_column       column;
+};
+
+// header names understood, any other column of a header is ignored
+constexpr ImportColumnName import_column_names[] = {
+    {"word", ic_word},              {"headword", ic_word},          {"head", ic_word},
+    {"class", ic_class},            {"pos", ic_class},              {"wordclass", ic_class},        {"partofspeech", ic_class},
+    {"definition", ic_definition},  {"defi", ic_definition},        {"meaning", ic_definition},
+    {"example", ic_example},        {"exam", ic_example},           {"sentence", ic_example},
+    {"category", ic_category},      {"cate", ic_category},          {"categories", ic_category},    {"tags", ic_category},
+    {"collocation", ic_collocation}, {"coll", ic_collocation}
+};
+
+// rows without a header: head word, class, definition, example, category
+static const std::vector<import_column> import_default_columns = {ic_word, ic_class, ic_definition, ic_example, ic_category};
+
+// what an import did
+struct ImportCounts
+{
+    size_t  rows = 0;
+    size_t  rejected = 0;   // rows without a head word made of letters only
+    size_t  replaced = 0;   // fields with characters the dict grammar cannot hold
+};
+
+// reads delimited rows into words, a chunk of the file at a time. a chunk
+// begins and ends on row boundaries, so chunks are parsed independently.
+class RowImporter
+{
+    import_format                       mFormat;
+    const std::vector<import_column>   &mColumns;
+    std::vector<std::string>            mFields;    // kept between rows, so their buffers are reused
+    size_t                              mCount = 0; // fields in the current row
+    std::string                         mText;
+    std::string                         mCategory;  // a category name being unescaped
+
+    // copies a field into mText the way it can be stored in dict: trimmed,
+    // with the characters that end items and line breaks turned to spaces
+    std::string_view                    clean(std::string_view s, ImportCounts &counts)
+    {
+        while(!s.empty() && isspace(uint8_t(s.front()))) s.remove_prefix(1);
+        while(!s.empty() && isspace(uint8_t(s.back()))) s.remove_suffix(1);
+        mText.assign(s.data(), s.size());
+        bool replaced = false;
+        for(char &c : mText)
+        {
+            if(c == '$' || c == ':' || c == ']') replaced = true;
+            if(c == '$' || c == ':' || c == ']' || c == '\n' || c == '\r' || c == '\t') c = ' ';
+        }
+        if(replaced) ++counts.replaced;
+        return mText;
+    }
+
+    // the word class of an imported class name: spelled like in dict,
+    // upper case and a trailing dot allowed
+    static WordClass                    normalizeClass(std::string_view s)
+    {
+        char name[16];
+        while(!s.empty() && (isspace(uint8_t(s.back())) || s.back() == '.')) s.remove_suffix(1);
+        while(!s.empty() && isspace(uint8_t(s.front()))) s.remove_prefix(1);
+        if(s.size() > sizeof(name)) return wc_unknown;
+        for(size_t i = 0; i < s.size(); ++i) name[i] = tolower(uint8_t(s[i]));
+        return getWordClass(std::string_view(name, s.size()));
+    }
+
+    // the field of the current row holding column c, empty if there is none
+    std::string_view                    column(import_column c) const
+    {
+        for(size_t i = 0; i < mColumns.size() && i < mCount; ++i) if(mColumns[i] == c) return mFields[i];
+        return std::string_view();
+    }
+
+    // the trimmed head word of the current row, empty unless it is made of letters only
+    std::string_view                    head() const
+    {
+        std::string_view s = column(ic_word);
+        while(!s.empty() && isspace(uint8_t(s.front()))) s.remove_prefix(1);
+        while(!s.empty() && isspace(uint8_t(s.back()))) s.remove_suffix(1);
+        if(!std::all_of(s.begin(), s.end(), [](char c) { return isalpha(uint8_t(c)); })) return std::string_view();
+        return s;
+    }
+
+    // adds the items of the current row to its word w
+    void                                addRow(Word &w, ImportCounts &counts)
+    {
+        std::string_view fields[ic_ignored] = {};
+        for(size_t i = 0; i < mColumns.size() && i < mCount; ++i)
+            if(mColumns[i] != ic_ignored) fields[mColumns[i]] = mFields[i];
+        std::string_view text = clean(fields[ic_definition], counts);
+        if(!text.empty())
+        {
+            // without a class column a leading "(class)" is taken like in dict
+            auto d = !fields[ic_class].empty() || text[0] != '(' ? std::make_pair(normalizeClass(fields[ic_class]), text) : splitDefinition(text);
+            addDefinition(w, d.first, d.second);
+        }
+        text = clean(fields[ic_example], counts);
+        if(!text.empty()) w.exam.emplace(text);
+        text = clean(fields[ic_collocation], counts);
+        if(!text.empty()) w.coll.emplace(text);
+        // categories are split at commas, "\," and "\\" stand for a comma
+        // and a backslash within a name
+        std::string_view c = fields[ic_category];
+        mCategory.clear();
+        for(size_t i = 0; i <= c.size(); ++i)
+        {
+            if(i < c.size() && c[i] != ',')
+            {
+                if(c[i] == '\\' && i + 1 < c.size() && (c[i + 1] == ',' || c[i + 1] == '\\')) ++i;
+                mCategory += c[i];
+                continue;
+            }
+            text = clean(mCategory, counts);
+            if(!text.empty()) w.cate.emplace(text);
+            mCategory.clear();
+        }
+    }
+
+public:
+    RowImporter(import_format format, const std::vector<import_column> &columns) : mFormat(format), mColumns(columns) {}
+
+    // adds a definition unless the word has it already, like add lines do
+    static void                         addDefinition(Word &w, WordClass cls, std::string_view text)
+    {
+        auto range = w.defi.equal_range(cls);
+        for(auto i = range.first; i != range.second; ++i) if(i->second == text) return;
+        w.defi.emplace_hint(range.second, cls, std::string(text));
+    }
+
+    // splits buf into rows and fields, calling f with the text of each row
+    // once its fields are read
+    template<class F> void              forEachRow(std::string_view buf, F &&f)
+    {
+        char separator = mFormat == import_csv ? ',' : '\t';
+        size_t pos = 0;
+        while(pos < buf.size())
+        {
+            size_t row = pos;
+            mCount = 0;
+            for(;;)
+            {
+                if(mCount == mFields.size()) mFields.emplace_back();
+                std::string &field = mFields[mCount++];
+                field.clear();
+                if(mFormat == import_csv && pos < buf.size() && buf[pos] == '"')
+                {
+                    // quoted: up to the lone closing quote, "" stands for "
+                    for(++pos;;)
+                    {
+                        size_t q = std::min(buf.find('"', pos), buf.size());
+                        field.append(buf.data() + pos, q - pos);
+                        if(q + 1 < buf.size() && buf[q + 1] == '"')
+                        {
+                            field.push_back('"');
+                            pos = q + 2;
+                            continue;
+                        }
+                        pos = std::min(q + 1, buf.size());
+                        break;
+                    }
+                }
+                size_t end = pos;
+                while(end < buf.size() && buf[end] != separator && buf[end] != '\n') ++end;
+                field.append(buf.data() + pos, end - pos);
+                if(!field.empty() && field.back() == '\r' && (end == buf.size() || buf[end] == '\n')) field.pop_back();
+                pos = end + 1;
+                if(end == buf.size() || buf[end] == '\n') break;
+            }
+            if(mCount > 1 || !mFields[0].empty()) f(buf.substr(row, pos - row));
+        }
+    }
+
+    // parses every row of buf into words. the rows are sorted by head word
+    // first and parsed again in that order, so each word is added at the end
+    // of the map instead of at a random place in it
+    void                                import(std::string_view buf, std::map<std::string, Word> &words, ImportCounts &counts)
+    {
+        struct Row
+        {
+            std::string         head;
+            std::string_view    text;
+        };
+        // the first 8 letters of a head word, big endian, and the row index:
+        // most rows compare without their strings, equal heads keep file order
+        std::vector<std::pair<uint64_t, uint32_t>> order;
+        std::vector<Row> rows;
+        forEachRow(buf, [&](std::string_view row) {
+            ++counts.rows;
+            std::string_view h = head();
+            if(h.empty())
+            {
+                ++counts.rejected;
+                return;
+            }
+            uint64_t prefix = 0;
+            for(size_t i = 0; i < 8; ++i) prefix = prefix << 8 | (i < h.size() ? uint8_t(h[i]) : 0);
+            order.emplace_back(prefix, uint32_t(rows.size()));
+            rows.push_back({std::string(h), row});
+        });
+        std::sort(order.begin(), order.end(), [&](const auto &a, const auto &b) {
+            if(a.first != b.first) return a.first < b.first;
+            const std::string &x = rows[a.second].head, &y = rows[b.second].head;
+            int c = x.compare(std::min<size_t>(8, x.size()), std::string::npos, y, std::min<size_t>(8, y.size()), std::string::npos);
+            return c != 0 ? c < 0 : a.second < b.second;
+        });
+        for(auto &o : order)
+        {
+            Row &r = rows[o.second];
+            auto i = words.empty() ? words.end() : std::prev(words.end());
+            if(i == words.end() || i->first != r.head)
+            {
+                i = words.emplace_hint(words.end(), r.head, Word());
+                i->second.word = r.head;
+            }
+            forEachRow(r.text, [&](std::string_view) { addRow(i->second, counts); });
+        }
+    }
+
+    size_t                              fieldCount() const { return mCount; }
+    const std::string&                  field(size_t i) const { return mFields[i]; }
+};
+
+// imports a delimited word list into dictionary. the file is read in
+// batches; every batch is cut into a chunk per thread on row boundaries,
+// the chunks are parsed into words in parallel and the words then merged
+// into the dictionary in file order. progress goes to std::cerr.
+bool importWords(Dictionary &dictionary, const char *path, import_format format, unsigned jobs)
+{
+    auto start = std::chrono::steady_clock::now();
+    FileView file(path);
+    std::string_view buf = file.view();
+    if(buf.empty())
+    {
+        std::cerr << "nothing to import from '" << path << "'." << std::endl;
+        return false;
+    }
+
+    // a first row naming a word column and at least one other known column is a header
+    std::vector<import_column> columns = import_default_columns;
+    size_t pos = 0;
+    {
+        RowImporter header(format, columns);
+        size_t end = buf.find('\n');
+        end = end == std::string_view::npos ? buf.size() : end + 1;
+        std::vector<import_column> named;
+        size_t known = 0;
+        header.forEachRow(buf.substr(0, end), [&](std::string_view) {
+            for(size_t k = 0; k < header.fieldCount(); ++k)
+            {
+                std::string name;
+                for(char c : header.field(k)) if(isalpha(uint8_t(c))) name.push_back(tolower(uint8_t(c)));
+                auto i = std::find_if(std::begin(import_column_names), std::end(import_column_names), [&](const ImportColumnName &n) { return n.name == name; });
+                named.push_back(i == std::end(import_column_names) ? ic_ignored : i->column);
+                if(named.back() != ic_ignored) ++known;
+            }
+        });
+        if(known >= 2 && std::count(named.begin(), named.end(), ic_word) == 1)
+        {
+            columns = named;
+            pos = end;
+        }
+    }
+
+    // the end of the row going on at p: the first line break outside quotes.
+    // quotes are counted from the last boundary, the file is read in order
+    size_t quotes_from = pos;
+    bool quoted = false;
+    auto boundary = [&](size_t p) {
+        if(p >= buf.size()) return buf.size();
+        if(format == import_csv)
+        {
+            quoted ^= std::count(buf.data() + quotes_from, buf.data() + p, '"') & 1;
+            for(; p < buf.size() && (quoted || buf[p] != '\n'); ++p)
+                if(buf[p] == '"') quoted = !quoted;
+        }
+        else
+        {
+            p = buf.find('\n', p);
+        }
+        quotes_from = p == std::string_view::npos ? buf.size() : p + 1;
+        return quotes_from;
+    };
+
+    const size_t batch = size_t(jobs) << 24;  // 16 MiB per thread
+    ImportCounts total;
+    size_t added = 0;
+    bool progress = isatty(STDERR_FILENO);
+    std::vector<RowImporter> importers(jobs, RowImporter(format, columns));
+    while(pos < buf.size())
+    {
+        std::vector<size_t> bounds{pos};
+        for(unsigned k = 1; k <= jobs; ++k)
+        {
+            size_t b = boundary(std::max(bounds.back(), pos + batch / jobs * k));
+            if(b > bounds.back()) bounds.push_back(b);
+        }
+        size_t chunks = bounds.size() - 1;
+        std::vector<std::map<std::string, Word>> parts(chunks);
+        std::vector<ImportCounts> counts(chunks);
+        std::vector<std::thread> pool;
+        for(size_t k = 1; k < chunks; ++k)
+            pool.emplace_back([&, k] { importers[k].import(buf.substr(bounds[k], bounds[k + 1] - bounds[k]), parts[k], counts[k]); });
+        importers[0].import(buf.substr(bounds[0], bounds[1] - bounds[0]), parts[0], counts[0]);
+        for(auto &t : pool) t.join();
+
+        for(size_t k = 0; k < chunks; ++k)
+        {
+            total.rows += counts[k].rows;
+            total.rejected += counts[k].rejected;
+            total.replaced += counts[k].replaced;
+            for(auto &part : parts[k])
+            {
+                Word &w = dictionary[part.first];
+                if(w.word.empty())
+                {
+                    w = std::move(part.second);
+                    ++added;
+                    continue;
+                }
+                for(auto &d : part.second.defi) RowImporter::addDefinition(w, d.first, d.second);
+                w.coll.insert(part.second.coll.begin(), part.second.coll.end());
+                w.exam.insert(part.second.exam.begin(), part.second.exam.end());
+                w.cate.insert(part.second.cate.begin(), part.second.cate.end());
+            }
+        }
+        pos = bounds.back();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(progress && seconds > 0)
+        {
+            std::cerr << "\rimported " << (pos >> 20) << " of " << (buf.size() >> 20) << " MiB, "
+                      << total.rows << " rows, " << size_t(pos / seconds) / (1 << 20) << " MiB/s" << std::flush;
+        }
+    }
+    if(progress) std::cerr << "\n";
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "imported " << total.rows << " rows, " << added << " new words in " << seconds << "s";
+    if(seconds > 0) std::cerr << " (" << size_t(buf.size() / seconds) / (1 << 20) << " MiB/s)";
+    if(total.rejected) std::cerr << ", " << total.rejected << " rows without a proper head word skipped";
+    if(total.replaced) std::cerr << ", " << total.replaced << " fields had '$', ':' or ']' replaced";
+    std::cerr << "." << std::endl;
+    return true;
+}
+
+// machine formats written by export
+enum export_format
+{
+    export_jsonl,   // one JSON object per word
+    export_csv      // rows import reads back: a row per definition, example or collocation
+};
+
+// appends s to out as a JSON string. bytes that are not valid UTF-8 become U+FFFD
+void appendJson(std::string &out, std::string_view s)
+{
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    size_t run = 0;
+    for(size_t i = 0; i < s.size();)
+    {
+        uint8_t c = s[i];
+        if(c >= 0x20 && c < 0x80 && c != '"' && c != '\\')
+        {
+            ++i;
+            continue;
+        }
+        // the length of a well formed UTF-8 sequence starting at i, 0 if there is none
+        size_t n = 0;
+        if(c >= 0xc2 && c <= 0xdf) n = 2;
+        else if(c >= 0xe0 && c <= 0xef) n = 3;
+        else if(c >= 0xf0 && c <= 0xf4) n = 4;
+        for(size_t k = 1; k < n; ++k)
+        {
+            uint8_t b = i + k < s.size() ? s[i + k] : 0;
+            // second bytes ruling out overlong forms, surrogates and code points past U+10FFFF
+            uint8_t lo = k > 1 ? 0x80 : c == 0xe0 ? 0xa0 : c == 0xf0 ? 0x90 : 0x80;
+            uint8_t hi = k > 1 ? 0xbf : c == 0xed ? 0x9f : c == 0xf4 ? 0x8f : 0xbf;
+            if(b < lo || b > hi) n = 0;
+        }
+        if(n > 0)
+        {
+            i += n;
+            continue;
+        }
+        out.append(s.data() + run, i - run);
+        switch(c)
+        {
+            case '"':   out += "\\\""; break;
+            case '\\':  out += "\\\\"; break;
+            case '\n':  out += "\\n"; break;
+            case '\r':  out += "\\r"; break;
+            case '\t':  out += "\\t"; break;
+            default:
+                if(c < 0x20)
+                {
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 15];
+                }
+                else
+                {
+                    out += "\xef\xbf\xbd";
+                }
+        }
+        run = ++i;
+    }
+    out.append(s.data() + run, s.size() - run);
+    out += '"';
+}
+
+// appends s to out as a CSV field, quoted if it holds a separator, a quote or a line break
+void appendCsv(std::string &out, std::string_view s)
+{
+    if(s.find_first_of(",\"\r\n") == std::string_view::npos)
+    {
+        out += s;
+        return;
+    }
+    out += '"';
+    for(char c : s)
+    {
+        if(c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+// appends w to out in format f
+void exportWord(std::string &out, const Word &w, export_format f)
+{
+    if(f == export_jsonl)
+    {
+        auto list = [&](const char *name, const std::set<std::string> &items) {
+            out += ",\"";
+            out += name;
+            out += "\":[";
+            for(auto i = items.begin(); i != items.end(); ++i)
+            {
+                if(i != items.begin()) out += ',';
+                appendJson(out, *i);
+            }
+            out += ']';
+        };
+        out += "{\"word\":";
+        appendJson(out, w.word);
+        out += ",\"definitions\":[";
+        for(auto i = w.defi.begin(); i != w.defi.end(); ++i)
+        {
+            if(i != w.defi.begin()) out += ',';
+            out += "{\"class\":\"";
+            out += wordClassName(i->first);
+            out += "\",\"text\":";
+            appendJson(out, i->second);
+            out += '}';
+        }
+        out += ']';
+        list("collocations", w.coll);
+        list("examples", w.exam);
+        list("categories", w.cate);
+        out += "}\n";
+        return;
+    }
+    // the i-th definition, example and collocation share a row, the
+    // categories go on the first one
+    auto d = w.defi.begin();
+    auto e = w.exam.begin();
+    auto c = w.coll.begin();
+    size_t rows = std::max({w.defi.size(), w.exam.size(), w.coll.size(), size_t(1)});
+    for(size_t i = 0; i < rows; ++i)
+    {
+        appendCsv(out, w.word);
+        out += ',';
+        if(d != w.defi.end())
+        {
+            out += wordClassName(d->first);
+            out += ',';
+            appendCsv(out, (d++)->second);
+        }
+        else
+        {
+            out += ',';
+        }
+        out += ',';
+        if(e != w.exam.end()) appendCsv(out, *e++);
+        out += ',';
+        if(c != w.coll.end()) appendCsv(out, *c++);
+        out += ',';
+        if(i == 0 && !w.cate.empty())
+        {
+            // joined by commas, escaped in names the way import reads them
+            std::string cate;
+            for(auto &k : w.cate)
+            {
+                if(!cate.empty()) cate += ',';
+                for(char ch : k)
+                {
+                    if(ch == ',' || ch == '\\') cate += '\\';
+                    cate += ch;
+                }
+            }
+            appendCsv(out, cate);
+        }
+        out += '\n';
+    }
+}
+
+// writes every word of the dictionary to path, or to stdout if path is "-".
+// words are gathered in rounds of a few thousand per thread while walking the
+// dictionary; the threads serialize their share into buffers of their own
+// and the buffers are written in order, a round behind, so writing overlaps
+// serializing the next round.
+bool exportDictionary(const Dictionary &dictionary, const std::string &path, export_format format, unsigned jobs)
+{
+    auto start = std::chrono::steady_clock::now();
+    int fd = path == "-" ? STDOUT_FILENO : open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+    {
+        std::cerr << "cannot open '" << path << "'." << std::endl;
+        return false;
+    }
+    // a word of the overlay, or the index of a base word when word is null
+    struct Entry
+    {
+        const Word  *word;
+        size_t      base;
+    };
+    const size_t per_thread = 4096;
+    std::vector<Entry> entries[2];
+    std::vector<std::string> buffers[2];
+    buffers[0].resize(jobs);
+    buffers[1].resize(jobs);
+    int current = 0;
+    size_t words = 0, bytes = 0;
+    bool good;
+    {
+        WriterBuffer buffer(fd);
+        std::ostream s(&buffer);
+        if(format == export_csv) s << "word,class,definition,example,collocation,category\n";
+        auto round = [&] {
+            std::vector<Entry> &e = entries[current];
+            std::vector<std::string> &out = buffers[current];
+            size_t share = (e.size() + jobs - 1) / jobs;
+            std::vector<std::thread> pool;
+            for(unsigned k = 0; k < jobs && k * share < e.size(); ++k)
+            {
+                pool.emplace_back([&, k] {
+                    out[k].clear();
+                    for(size_t i = k * share; i < std::min(e.size(), (k + 1) * share); ++i)
+                        exportWord(out[k], e[i].word ? *e[i].word : dictionary.base()->get(e[i].base), format);
+                });
+            }
+            // the round before is written while this one is serialized
+            for(auto &b : buffers[1 - current])
+            {
+                s.write(b.data(), b.size());
+                bytes += b.size();
+                b.clear();
+            }
+            for(auto &t : pool) t.join();
+            words += e.size();
+            e.clear();
+            current = 1 - current;
+        };
+        auto add = [&](const Entry &entry) {
+            entries[current].push_back(entry);
+            if(entries[current].size() == per_thread * jobs) round();
+        };
+        dictionary.walk([&](const Word &w) { add({&w, 0}); }, [&](size_t i) { add({nullptr, i}); });
+        // the last words, then the round holding them
+        round();
+        round();
+        good = bool(s.flush());
+    }
+    if((fd != STDOUT_FILENO && ::close(fd) != 0) || !good)
+    {
+        std::cerr << "cannot write '" << path << "'." << std::endl;
+        return false;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "exported " << words << " words, " << (bytes >> 20) << " MiB in " << seconds << "s";
+    if(seconds > 0) std::cerr << " (" << size_t(bytes / seconds) / (1 << 20) << " MiB/s)";
+    std::cerr << "." << std::endl;
+    return true;
+}
+
+#ifdef VOC_BENCH
+// writes a synthetic dictionary of n words to s. head words are unique
+// strings of syllables, every word gets up to the given number of items of
+// each kind, and example sentences draw their words from a Zipf-like
+// distribution over the dictionary, so text indexes see realistic term
+// frequencies. the same n and limits always give the same file.
+void generateDictionary(std::ostream &s, size_t n, unsigned defi, unsigned coll, unsigned exam, unsigned cate)
+{
+    static const char *onsets[] = {"b", "c", "d", "f", "g", "h", "k", "l", "m", "n", "p", "r", "s", "t", "v", "w", "br", "ch", "cl", "dr", "gr", "pl", "sh", "st", "th"};
+    static const char *vowels[] = {"a", "e", "i", "o", "u", "ai", "ea", "ou"};
+    static const char *fillers[] = {"the", "a", "of", "to", "and", "in", "is", "it", "that", "was", "for", "on", "with", "as", "by", "at", "from"};
+    static const char *categories[] = {"weather", "travel", "food", "music", "sport", "work", "school", "home", "nature", "health",
+                                       "money", "family", "science", "art", "law", "sea", "city", "time", "body", "colour"};
+    // a syllable is an onset and a vowel, which splits any word back into
+    // its syllables in one way only
+    const size_t syllables = std::size(onsets) * std::size(vowels);
+
+    // word i is the syllable digits of i scrambled by a multiplier coprime
+    // to n, so neighbours in the file are not neighbours in sound
+    size_t digits = 2;
+    for(size_t cap = syllables * syllables; cap < n; cap *= syllables) ++digits;
+    uint64_t scramble = 0x9e3779b97f4a7c15ull % std::max<size_t>(n, 1);
+    while(std::gcd<uint64_t, uint64_t>(scramble, n) > 1) ++scramble;
+    auto head = [&](size_t i) {
+        uint64_t x = uint64_t((unsigned __int128)i * scramble % std::max<size_t>(n, 1));
+        std::string w;
+        for(size_t d = 0; d < digits; ++d, x /= syllables)
+        {
+            w += onsets[x % syllables % std::size(onsets)];
+            w += vowels[x % syllables / std::size(onsets)];
+        }
+        return w;
+    };
+
+    std::mt19937_64 rng(n);
+    // rank r is drawn with probability about 1/r
+    std::vector<double> weights;
+    size_t vocabulary = std::min<size_t>(n, 50000);
+    for(size_t r = 0; r < vocabulary + std::size(fillers); ++r) weights.push_back(1.0 / (r + 1));
+    std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    auto token = [&]() -> std::string {
+        size_t r = zipf(rng);
+        return r < std::size(fillers) ? fillers[r] : head(r - std::size(fillers));
+    };
+    auto sentence = [&](size_t min, size_t max, const std::string &with) {
+        size_t len = min + rng() % (max - min + 1), at = rng() % len;
+        std::string t;
+        for(size_t i = 0; i < len; ++i)
+        {
+            if(i) t += ' ';
+            t += i == at ? with : token();
+        }
+        return t;
+    };
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        Word w;
+        w.word = head(i);
+        for(unsigned k = rng() % (defi + 1); k > 0; --k)
+            w.defi.emplace(WordClass(rng() % word_class_count), sentence(3, 10, token()));
+        for(unsigned k = rng() % (coll + 1); k > 0; --k)
+            w.coll.insert(rng() % 2 ? w.word + " " + token() : token() + " " + w.word);
+        for(unsigned k = rng() % (exam + 1); k > 0; --k)
+            w.exam.insert(sentence(5, 14, w.word));
+        for(unsigned k = rng() % (cate + 1); k > 0; --k)
+            w.cate.insert(categories[rng() % std::size(categories)]);
+        s << w;
+    }
+    s.flush();
+}
+
+// times the hot paths on a dictionary file and prints one json object per
+// line: name, items processed, seconds and items per second
+void benchDictionary(const char *path, unsigned jobs, std::ostream &out)
+{
+    typedef std::chrono::steady_clock clock;
+    auto seconds = [](clock::time_point since) { return std::chrono::duration<double>(clock::now() - since).count(); };
+    auto report = [&](const char *name, size_t items, double s) {
+        out << "{\"name\": \"" << name << "\", \"items\": " << items << ", \"seconds\": " << s
+            << ", \"per_second\": " << (s > 0 ? size_t(items / s) : 0) << "}\n";
+    };
+    bool colors = ConsoleColorModifier::enabled;
+    ConsoleColorModifier::enabled = false;
+    int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+    // Word::operator>> over the file
+    size_t records = 0;
+    auto t = clock::now();
+    {
+        std::ifstream file(path);
+        for(Word w; file >> w; w = Word()) ++records;
+    }
+    report("parse_stream", records, seconds(t));
+
+    // what main() does on start: parse and merge duplicates
+    Dictionary dictionary;
+    t = clock::now();
+    records = loadDictionary(path, dictionary.words(), jobs);
+    report("load", records, seconds(t));
+
+    std::vector<std::string> keys;
+    dictionary.forEachName(std::string(), [&](std::string_view w) { keys.emplace_back(w); });
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    size_t found = 0;
+    t = clock::now();
+    for(auto &k : keys) found += dictionary.find(k) != nullptr;
+    report("lookup", found, seconds(t));
+
+    // the first query builds the radix tree
+    t = clock::now();
+    dictionary.countPrefixed(std::string());
+    report("prefix_index", keys.size(), seconds(t));
+    std::vector<std::string> prefixes;
+    for(size_t i = 0; i < keys.size() && prefixes.size() < 10000; ++i) prefixes.push_back(keys[i].substr(0, 2 + i % 3));
+    size_t suggested = 0;
+    t = clock::now();
+    for(auto &p : prefixes)
+    {
+        dictionary.countPrefixed(p);
+        suggested += dictionary.suggest(p, suggestion_limit).size() > 0;
+    }
+    report("prefix_suggest", prefixes.size(), seconds(t));
+
+    // add lines committed to words, in memory and then through a journal
+    std::vector<std::vector<std::string>> lines;
+    std::ostream no_echo(nullptr);
+    for(size_t i = 0; i < keys.size() && i < 10000; ++i)
+    {
+        lines.emplace_back();
+        std::string line = "A benchmark sentence for [" + keys[i] + "] number " + std::to_string(i) + "\n";
+        for(char c : line) readAddContent(lines.back(), c, no_echo);
+    }
+    Journal unsynced;
+    std::ostream discard(nullptr);
+    t = clock::now();
+    for(auto v : lines) applyAddContent(dictionary, unsynced, v, discard);
+    report("add", lines.size(), seconds(t));
+    {
+        char name[] = "/tmp/dict-bench-journal-XXXXXX";
+        int fd = mkstemp(name);
+        if(fd >= 0) close(fd);
+        Journal journal;
+        if(fd >= 0 && journal.open(name, 0))
+        {
+            size_t n = std::min<size_t>(lines.size(), 200);
+            t = clock::now();
+            for(size_t i = 0; i < n; ++i)
+            {
+                auto v = lines[i];
+                applyAddContent(dictionary, journal, v, discard);
+            }
+            report("add_journaled", n, seconds(t));
+        }
+        if(fd >= 0) unlink(name);
+    }
+
+    // Word::operator<< over every word, as compaction writes dict
+    {
+        FdBuffer buffer(null);
+        std::ostream s(&buffer);
+        t = clock::now();
+        dictionary.write(s);
+        s.flush();
+        report("save", keys.size(), seconds(t));
+    }
+    {
+        FdBuffer buffer(null);
+        std::ostream s(&buffer);
+        t = clock::now();
+        dictionary.forEach([&](const Word &w) { w.print(s); });
+        s.flush();
+        report("print", keys.size(), seconds(t));
+    }
+    out.flush();
+    close(null);
+    ConsoleColorModifier::enabled = colors;
+}
+#endif
+
+// reader threads an EpochDomain takes at once
+static const size_t epoch_slots = 256;
+
+// epoch-based reclamation for objects readers reach without taking locks.
+// a reader pins the current epoch in its slot while it holds pointers, and
+// an object retired in epoch e is only freed once no slot is pinned at e or
+// earlier.
+class EpochDomain
+{
+    static const size_t     slot_count = epoch_slots;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t>   epoch{0};       // 0 while not reading
+        std::atomic<bool>       taken{false};
+    };
+
+    std::atomic<uint64_t>                                       mEpoch{1};
+    Slot                                                        mSlots[slot_count];
+    std::mutex                                                  mRetiredLock;
+    std::vector<std::pair<uint64_t, std::function<void()>>>     mRetired;
+
+public:
+    ~EpochDomain() { for(auto &r : mRetired) r.second(); }
+
+    // a slot for one reader thread, -1 if all are taken
+    int                 join()
+    {
+        for(size_t i = 0; i < slot_count; ++i)
+        {
+            bool free = false;
+            if(mSlots[i].taken.compare_exchange_strong(free, true)) return int(i);
+        }
+        return -1;
+    }
+
+    void                leave(int slot) { mSlots[slot].taken = false; }
+    void                pin(int slot) { mSlots[slot].epoch = mEpoch.load(); }
+    void                unpin(int slot) { mSlots[slot].epoch = 0; }
+
+    // frees the object through f once no reader can still hold it. call
+    // after the object has been unlinked.
+    void                retire(std::function<void()> f)
+    {
+        std::lock_guard<std::mutex> lock(mRetiredLock);
+        mRetired.emplace_back(mEpoch.fetch_add(1), std::move(f));
+        uint64_t oldest = UINT64_MAX;
+        for(auto &s : mSlots)
+        {
+            uint64_t e = s.epoch;
+            if(e != 0) oldest = std::min(oldest, e);
+        }
+        auto freed = std::partition(mRetired.begin(), mRetired.end(), [&](const std::pair<uint64_t, std::function<void()>> &r) {
+            return r.first >= oldest;
+        });
+        for(auto i = freed; i != mRetired.end(); ++i) i->second();
+        mRetired.erase(freed, mRetired.end());
+    }
+};
+
+// a state of a dictionary that does not change once published: a shared
+// base and the words edited since it was laid out, in order
+struct DictionaryVersion
+{
+    struct Edit
+    {
+        std::shared_ptr<const Word> record;     // only the head word if removed
+        bool                        removed;
+    };
+
+    std::shared_ptr<const WordSource>   base;
+    std::vector<Edit>                   edits;
+
+    std::vector<Edit>::const_iterator   lowerEdit(std::string_view w) const
+    {
+        return std::lower_bound(edits.begin(), edits.end(), w, [](const Edit &e, std::string_view w) { return e.record->word < w; });
+    }
+
+    bool                                inBase(std::string_view w) const { return base->find(w) != base->size(); }
+
+    bool                                find(const std::string &w, Word &out) const
+    {
+        auto e = lowerEdit(w);
+        if(e != edits.end() && e->record->word == w)
+        {
+            if(e->removed) return false;
+            out = *e->record;
+            return true;
+        }
+        size_t i = base->find(w);
+        if(i == base->size()) return false;
+        out = base->get(i);
+        return true;
+    }
+
+    // number of head words starting with prefix, the first limit of which
+    // are appended to out in order
+    size_t                              complete(const std::string &prefix, size_t limit, std::vector<std::string> &out) const
+    {
+        // base words with the prefix end where the prefix incremented would start
+        std::string next = prefix;
+        while(!next.empty() && uint8_t(next.back()) == 0xff) next.pop_back();
+        size_t s = base->lowerBound(prefix), send = base->size();
+        if(!next.empty())
+        {
+            ++next.back();
+            send = base->lowerBound(next);
+        }
+        size_t count = send - s;
+        auto e = lowerEdit(prefix), eend = e;
+        for(; eend != edits.end() && eend->record->word.compare(0, prefix.size(), prefix) == 0; ++eend)
+        {
+            bool in_base = inBase(eend->record->word);
+            if(eend->removed && in_base) --count;
+            else if(!eend->removed && !in_base) ++count;
+        }
+        while(out.size() < limit && (s < send || e != eend))
+        {
+            if(e != eend && (s == send || e->record->word <= base->word(s)))
+            {
+                if(s < send && e->record->word == base->word(s)) ++s;
+                if(!e->removed) out.push_back(e->record->word);
+                ++e;
+            }
+            else
+            {
+                out.emplace_back(base->word(s++));
+            }
+        }
+        return count;
+    }
+};
+
+// a dictionary shared between reader threads and writers. readers use the
+// published version without taking locks, writers take turns at editing the
+// dictionary and publish a new version after each edit.
+class SharedDictionary
+{
+    Dictionary                                  &mDictionary;   // only touched under mWriteLock
+    Journal                                     &mJournal;
+    std::mutex                                  mWriteLock;
+    std::atomic<const DictionaryVersion*>       mCurrent{nullptr};
+    EpochDomain                                 mEpochs;
+
+    // publishes a version holding the current record of w, call under mWriteLock
+    void                publish(const std::string &w)
+    {
+        const DictionaryVersion *old = mCurrent.load();
+        auto next = std::make_unique<DictionaryVersion>();
+        // copying the edits costs as much as they are many, so past a
+        // point they are folded into a new base
+        if(old == nullptr || old->edits.size() >= std::max<size_t>(1024, old->base->size() / 64))
+        {
+            mDictionary.rebase();
+            next->base = mDictionary.sharedBase();
+        }
+        else
+        {
+            next->base = old->base;
+            next->edits = old->edits;
+            DictionaryVersion::Edit edit;
+            Word *record = mDictionary.find(w);
+            edit.removed = record == nullptr;
+            if(record) edit.record = std::make_shared<const Word>(*record);
+            else
+            {
+                auto head = std::make_shared<Word>();
+                head->word = w;
+                edit.record = std::move(head);
+            }
+            auto i = next->edits.begin() + (old->lowerEdit(w) - old->edits.begin());
+            if(i != next->edits.end() && i->record->word == w) *i = std::move(edit);
+            else next->edits.insert(i, std::move(edit));
+        }
+        mCurrent.store(next.release());
+        if(old) mEpochs.retire([old] { delete old; });
+    }
+
+public:
+    SharedDictionary(Dictionary &dictionary, Journal &journal) : mDictionary(dictionary), mJournal(journal)
+    {
+        publish(std::string());
+    }
+
+    ~SharedDictionary() { delete mCurrent.load(); }
+
+    int                 join() { return mEpochs.join(); }
+    void                leave(int slot) { mEpochs.leave(slot); }
+
+    // calls f with the current version, from a thread holding slot
+    template<class F> auto read(int slot, F &&f)
+    {
+        struct Pin
+        {
+            EpochDomain &epochs;
+            int         slot;
+            ~Pin() { epochs.unpin(slot); }
+        } pin{mEpochs, slot};
+        mEpochs.pin(slot);
+        return f(*mCurrent.load());
+    }
+
+    // applies an add line, without its '+'. returns false with error
+    // filled if it cannot be parsed.
+    bool                add(std::string_view line, std::ostream &out, AnnotationError &error)
+    {
+        std::vector<std::string> v;
+        if(!parseAnnotation(line, v, error)) return false;
+        std::lock_guard<std::mutex> lock(mWriteLock);
+        applyAddContent(mDictionary, mJournal, v, out);
+        publish(v[vo_head_word]);
+        return true;
+    }
+
+    bool                remove(const std::string &w)
+    {
+        std::lock_guard<std::mutex> lock(mWriteLock);
+        if(!mDictionary.erase(w)) return false;
+        mJournal.remove(w);
+        publish(w);
+        return true;
+    }
+};
+
+// daemon protocol. a request is one line, "<command> <argument>", where the
+// command is lookup, prefix, add (the argument is an add line without its
+// '+'), remove, or stats without argument. the answer is "ok <n>\n" followed
+// by n bytes of text, or "error <message>\n". lookups and prefixes are
+// answered from the published version by the thread holding slot.
+std::string answerRequest(SharedDictionary &dictionary, int slot, std::string_view line)
+{
+    size_t space = line.find(' ');
+    std::string_view command = line.substr(0, space);
+    std::string arg(space == std::string_view::npos ? std::string_view() : line.substr(space + 1));
+    std::ostringstream body;
+    Stopwatch watch;
+    if(command == "lookup" && !arg.empty())
+    {
+        Word w;
+        bool found = dictionary.read(slot, [&](const DictionaryVersion &v) { return v.find(arg, w); });
+        if(found) w.print(body);
+        stats.latency(sc_lookup, watch.lap());
+        if(!found) return "error word '" + arg + "' not found\n";
+    }
+    else if(command == "prefix")
+    {
+        std::vector<std::string> matches;
+        size_t count = dictionary.read(slot, [&](const DictionaryVersion &v) { return v.complete(arg, suggestion_limit, matches); });
+        for(auto &m : matches) body << m << '\n';
+        if(count > matches.size()) body << "... and " << count - matches.size() << " more.\n";
+        stats.latency(sc_prefix, watch.lap());
+    }
+    else if(command == "add")
+    {
+        AnnotationError error;
+        bool added = dictionary.add(arg, body, error);
+        stats.latency(sc_add, watch.lap());
+        if(!added) return "error " + std::string(error.message) + " at column " + std::to_string(error.column) + "\n";
+    }
+    else if(command == "remove" && !arg.empty())
+    {
+        bool removed = dictionary.remove(arg);
+        stats.latency(sc_remove, watch.lap());
+        if(!removed) return "error word '" + arg + "' not found\n";
+        body << "removed '" << arg << "'.\n";
+    }
+    else if(command == "stats" && arg.empty())
+    {
+        stats.report(body);
+    }
+    else
+    {
+        return "error bad request\n";
+    }
+    std::string s = body.str();
+    return "ok " + std::to_string(s.size()) + "\n" + s;
+}
+
+// longest request line a client may send
+static const size_t request_limit = 1 << 20;
+
+// keeps dictionary resident and answers requests from any number of clients
+// on a unix socket. each of threads runs its own epoll loop over the
+// connections it accepted. returns once SIGINT or SIGTERM arrives.
+int serveDictionary(Dictionary &dictionary, Journal &journal, const char *path, unsigned threads)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path))
+    {
+        std::cerr << "socket path too long." << std::endl;
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listener < 0) return 1;
+    // a socket file nobody answers on is left over from a crash
+    if(connect(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+    {
+        std::cerr << "a server is already listening on '" << path << "'." << std::endl;
+        close(listener);
+        return 1;
+    }
+    close(listener);
+    unlink(path);
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 64) != 0)
+    {
+        std::cerr << "cannot listen on '" << path << "': " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    // the signals are taken by sigwait below, the threads inherit the mask
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    // becomes readable to wake every thread up for exiting
+    int stop = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    SharedDictionary shared(dictionary, journal);
+    // every thread reads through a slot of its own
+    threads = std::min<unsigned>(threads, epoch_slots);
+    std::cerr << "serving " << dictionary.countPrefixed(std::string()) << " words on '" << path << "' with " << threads << " threads." << std::endl;
+
+    auto worker = [&] {
+        struct Connection
+        {
+            std::string in, out;
+            uint32_t    events = EPOLLIN;   // registered with epoll
+            bool        closed = false;     // the client is done sending, only answers are left
+        };
+        std::unordered_map<int, Connection> connections;
+        int slot = shared.join();
+        int ep = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.fd = listener;
+        epoll_ctl(ep, EPOLL_CTL_ADD, listener, &ev);
+        ev.events = EPOLLIN;
+        ev.data.fd = stop;
+        epoll_ctl(ep, EPOLL_CTL_ADD, stop, &ev);
+
+        auto drop = [&](int fd) {
+            epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+            connections.erase(fd);
+        };
+        // sends what it can of c.out, waits for EPOLLOUT while some is left.
+        // a closed connection only waits for EPOLLOUT, its EOF would wake
+        // every epoll_wait
+        auto flush = [&](int fd, Connection &c) {
+            while(!c.out.empty())
+            {
+                ssize_t n = write(fd, c.out.data(), c.out.size());
+                if(n < 0 && errno == EINTR) continue;
+                if(n < 0 && errno != EAGAIN) return false;
+                if(n < 0) break;
+                c.out.erase(0, n);
+            }
+            uint32_t events = c.closed ? uint32_t(EPOLLOUT) : EPOLLIN | (c.out.empty() ? 0 : uint32_t(EPOLLOUT));
+            if(c.events != events)
+            {
+                c.events = events;
+                epoll_event e = {};
+                e.events = events;
+                e.data.fd = fd;
+                epoll_ctl(ep, EPOLL_CTL_MOD, fd, &e);
+            }
+            return true;
+        };
+
+        epoll_event events[64];
+        for(bool stopping = false; !stopping;)
+        {
+            int n = epoll_wait(ep, events, 64, -1);
+            if(n < 0 && errno == EINTR) continue;
+            if(n < 0) break;
+            for(int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                if(fd == stop)
+                {
+                    stopping = true;
+                    continue;
+                }
+                if(fd == listener)
+                {
+                    for(int client; (client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0;)
+                    {
+                        epoll_event e = {};
+                        e.events = EPOLLIN;
+                        e.data.fd = client;
+                        epoll_ctl(ep, EPOLL_CTL_ADD, client, &e);
+                        connections[client];
+                    }
+                    continue;
+                }
+                Connection &c = connections[fd];
+                // a request longer than request_limit ends the connection, as
+                // do answers the client does not read
+                bool overrun = false;
+                if(!c.closed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                {
+                    char block[1 << 16];
+                    while(!overrun && c.out.size() <= request_limit * 64)
+                    {
+                        ssize_t r = read(fd, block, sizeof(block));
+                        if(r < 0 && errno == EINTR) continue;
+                        if(r < 0 && errno == EAGAIN) break;
+                        if(r <= 0)
+                        {
+                            c.closed = true;
+                            break;
+                        }
+                        c.in.append(block, r);
+                        size_t begin = 0;
+                        for(size_t end; (end = c.in.find('\n', begin)) != std::string::npos; begin = end + 1)
+                        {
+                            std::string_view line = std::string_view(c.in).substr(begin, end - begin);
+                            if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                            c.out += answerRequest(shared, slot, line);
+                        }
+                        c.in.erase(0, begin);
+                        overrun = c.in.size() > request_limit;
+                    }
+                }
+                if(overrun || !flush(fd, c) || (c.closed && c.out.empty()) || c.out.size() > request_limit * 64) drop(fd);
+            }
+        }
+        for(auto &c : connections) close(c.first);
+        close(ep);
+        shared.leave(slot);
+    };
+    std::vector<std::thread> workers;
+    for(unsigned i = 0; i < threads; ++i) workers.emplace_back(worker);
+
+    int signum;
+    sigwait(&stop_signals, &signum);
+    uint64_t one = 1;
+    if(write(stop, &one, sizeof(one)) < 0) std::cerr << "failed to stop server threads." << std::endl;
+    for(auto &t : workers) t.join();
+
+    close(stop);
+    close(listener);
+    unlink(path);
+    pthread_sigmask(SIG_UNBLOCK, &stop_signals, nullptr);
+    std::cerr << "server stopped." << std::endl;
+    return 0;
+}
+
+// sends request lines to a server and prints the answers: the words of
+// request if there are any, otherwise every line of stdin. fails if the
+// server could not be reached or refused a request.
+int runClient(const char *path, const std::vector<std::string> &request)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        std::cerr << "cannot connect to '" << path << "': " << strerror(errno) << std::endl;
+        return 1;
+    }
+    std::string buffer;
+    bool refused = false;
+    // reads until buffer holds at least n bytes
+    auto fill = [&](size_t n) {
+        char block[1 << 16];
+        while(buffer.size() < n)
+        {
+            ssize_t r = read(fd, block, sizeof(block));
+            if(r < 0 && errno == EINTR) continue;
+            if(r <= 0) return false;
+            buffer.append(block, r);
+        }
+        return true;
+    };
+    auto ask = [&](const std::string &line) {
+        std::string msg = line + "\n";
+        for(size_t sent = 0; sent < msg.size();)
+        {
+            ssize_t w = write(fd, msg.data() + sent, msg.size() - sent);
+            if(w < 0 && errno == EINTR) continue;
+            if(w <= 0) return false;
+            sent += w;
+        }
+        size_t eol;
+        while((eol = buffer.find('\n')) == std::string::npos)
+            if(!fill(buffer.size() + 1)) return false;
+        std::string header = buffer.substr(0, eol);
+        buffer.erase(0, eol + 1);
+        if(header.compare(0, 3, "ok ") != 0)
+        {
+            std::cerr << header << std::endl;
+            refused = true;
+            return true;
+        }
+        size_t size = strtoull(header.c_str() + 3, nullptr, 10);
+        if(!fill(size)) return false;
+        std::cout.write(buffer.data(), size);
+        std::cout.flush();
+        buffer.erase(0, size);
+        return true;
+    };
+
+    bool ok = true;
+    if(!request.empty())
+    {
+        std::string line = request[0];
+        for(size_t i = 1; i < request.size(); ++i) line += " " + request[i];
+        ok = ask(line);
+    }
+    else
+    {
+        for(std::string line; ok && std::getline(std::cin, line);)
+            if(!line.empty()) ok = ask(line);
+    }
+    close(fd);
+    if(!ok) std::cerr << "connection to server lost." << std::endl;
+    return (ok && !refused) ? 0 : 1;
+}
+
+void printUsage(const char *name)
+{
+    std::string options(strlen(name) + 8, ' '); // continues the first line
+    std::cerr << "usage: " << name << " [-j|--jobs <threads>] [--arena|--flat|--lazy] [--color|--no-color]\n"
+              << options << "[--socket <path>] [--stats] [--memory <MiB>]\n"
+              << options << "[--autosave <seconds>]\n"
+              << "       " << name << " batch [<file>]                   answer lookups and add lines from a file or stdin\n"
+              << "       " << name << " serve                            keep the dictionary loaded and answer clients\n"
+              << "       " << name << " client [<request>]               send a request, or stdin lines, to the server\n"
+              << "       " << name << " snapshot [<dict> [<snapshot>]]   convert text to binary snapshot\n"
+              << "       " << name << " text [<snapshot> [<dict>]]       convert binary snapshot to text\n"
+              << "       " << name << " compact                          fold the journal into dict\n"
+              << "       " << name << " backups                          list backup generations\n"
+              << "       " << name << " diff <generation> [<generation>] compare a backup with another or dict\n"
+              << "       " << name << " restore <generation>             replace dict with a backup\n"
+              << "       " << name << " check [<dict> [<repaired>]]      report problems in a dict, optionally write it repaired\n"
+              << "       " << name << " ingest <file>                    add every line of a file of add lines, in one pass\n"
+              << "       " << name << " import <file> [tsv|csv]          add the rows of a word list: head word, class,\n"
+              << "                                                definition, example, category, or named by a header\n"
+              << "       " << name << " export <output> [jsonl|csv]      write every word as JSON lines or CSV rows, - for stdout\n"
+              << "       " << name << " merge <output> <dict>...         merge dicts into one sorted file, in bounded memory\n"
+              << "       " << name << " search <query>                   find words by the text of their items\n"
+              << "       " << name << " category <expression>            list words by category, e.g. 'a & (b | !c)'" << std::endl;
+#ifdef VOC_BENCH
+    std::cerr << "       " << name << " generate <words> [<defi> <coll> <exam> <cate>]\n"
+              << "                                                write a synthetic dict to stdout, with up to\n"
+              << "                                                that many items of each kind per word, 1000 at most\n"
+              << "       " << name << " bench [<dict>]                   time the hot paths, one json line each\n"
+              << "       " << name << " bench-layout [<dict>]            compare node and flat word layouts\n"
+              << "       " << name << " bench-render [<dict>]            compare ways of printing words" << std::endl;
+#endif
+}
+
+#ifdef VOC_BENCH
+// reads a count given on the command line, false unless it is a number
+// no greater than max
+bool parseCount(const std::string &arg, unsigned long max, unsigned long &n)
+{
+    char *end;
+    errno = 0;
+    n = strtoul(arg.c_str(), &end, 10);
+    return !arg.empty() && isdigit(static_cast<unsigned char>(arg[0])) && !*end && !errno && n <= max;
+}
+
+// runs the commands only the benchmark build has, returns their exit
+// status, or -1 if args names none of them
+int runBench(const std::vector<std::string> &args, const Options &options, const char *name)
+{
+    if(args[0] == "generate" && (args.size() == 2 || args.size() == 6))
+    {
+        unsigned long n, limits[4] = {3, 2, 4, 2};
+        bool ok = parseCount(args[1], UINT32_MAX, n);
+        for(size_t i = 2; ok && i < args.size(); ++i) ok = parseCount(args[i], 1000, limits[i - 2]);
+        if(!ok)
+        {
+            printUsage(name);
+            return 1;
+        }
+        FdBuffer buffer(STDOUT_FILENO);
+        std::ostream out(&buffer);
+        generateDictionary(out, n, limits[0], limits[1], limits[2], limits[3]);
+        return 0;
+    }
+    if(args[0] == "bench" && args.size() <= 2)
+    {
+        benchDictionary(args.size() > 1 ? args[1].c_str() : "dict", options.jobs, std::cout);
+        return 0;
+    }
+    if(args[0] == "bench-render" && args.size() <= 2)
+    {
+        benchRender(args.size() > 1 ? args[1].c_str() : "dict", std::cout);
+        return 0;
+    }
+    if(args[0] == "bench-layout" && args.size() <= 2)
+    {
+        benchLayouts(args.size() > 1 ? args[1].c_str() : "dict", std::cout);
+        return 0;
+    }
+    return -1;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    std::vector<std::string> args;
+    int color = -1; // colors only go to a terminal unless asked for
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if((arg == "-j" || arg == "--jobs") && i + 1 < argc)
+        {
+            options.jobs = std::max(1, atoi(argv[++i]));
+        }
+        else if(arg == "--arena")
+        {
+            options.storage = storage_arena;
+        }
+        else if(arg == "--flat")
+        {
+            options.storage = storage_flat;
+        }
+        else if(arg == "--lazy")
+        {
+            options.storage = storage_lazy;
+        }
+        else if(arg == "--no-color")
+        {
+            color = 0;
+        }
+        else if(arg == "--color")
+        {
+            color = 1;
+        }
+        else if(arg == "--socket" && i + 1 < argc)
+        {
+            options.socket = argv[++i];
+        }
+        else if(arg == "--stats")
+        {
+            options.stats = true;
+        }
+        else if(arg == "--autosave" && i + 1 < argc)
+        {
+            options.autosave = strtoul(argv[++i], nullptr, 10);
+        }
+        else if(arg == "--memory" && i + 1 < argc)
+        {
+            options.memory = std::max(1ul, strtoul(argv[++i], nullptr, 10)) << 20;
+        }
+        else if(arg.size() > 1 && arg[0] == '-')
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            args.push_back(std::move(arg));
+        }
+    }
+
+    ConsoleColorModifier::enabled = color < 0 ? isatty(STDOUT_FILENO) : color;
+    if(options.stats) atexit([] { stats.report(std::cerr); });
+
+    Dictionary dictionary;
+    std::fstream file;
+    int batch_fd = -1;
+
+    if(!args.empty())
+    {
+        if(args[0] == "snapshot" && args.size() <= 3)
+        {
+            const char *in = args.size() > 1 ? args[1].c_str() : "dict";
+            const char *out = args.size() > 2 ? args[2].c_str() : "dict.snap";
+            loadDictionary(in, dictionary.words(), options.jobs);
+            return writeSnapshot(out, dictionary) ? 0 : 1;
+        }
+        if(args[0] == "text" && args.size() <= 3)
+        {
+            const char *in = args.size() > 1 ? args[1].c_str() : "dict.snap";
+            const char *out = args.size() > 2 ? args[2].c_str() : "dict";
+            if(!dictionary.openSnapshot(in)) return 1;
+            file.open(out, std::ios_base::out);
+            dictionary.write(file);
+            file.close();
+            return file ? 0 : 1;
+        }
+        if(args[0] == "compact" && args.size() == 1)
+        {
+            Journal journal;
+            return saveDictionary(dictionary, openDictionary(dictionary, &journal, options)) ? 0 : 1;
+        }
+        if(args[0] == "search" && args.size() >= 2)
+        {
+            std::string query = args[1];
+            for(size_t i = 2; i < args.size(); ++i) query += " " + args[i];
+            openDictionary(dictionary, nullptr, options);
+            searchText(dictionary, query, std::cout);
+            return 0;
+        }
+        if(args[0] == "category" && args.size() >= 2)
+        {
+            std::string query = args[1];
+            for(size_t i = 2; i < args.size(); ++i) query += " " + args[i];
+            openDictionary(dictionary, nullptr, options);
+            return listCategories(dictionary, query, std::cout) ? 0 : 1;
+        }
+        if(args[0] == "check" && args.size() <= 3)
+        {
+            const char *in = args.size() > 1 ? args[1].c_str() : "dict";
+            DictChecker checker(in, std::cout);
+            if(args.size() < 3) return checker.run(nullptr) ? 0 : 1;
+            struct stat a, b;
+            if(stat(in, &a) == 0 && stat(args[2].c_str(), &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino)
+            {
+                std::cerr << "the repaired file has to be another file." << std::endl;
+                return 1;
+            }
+            int fd = open(args[2].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if(fd < 0)
+            {
+                std::cerr << "cannot open '" << args[2] << "'." << std::endl;
+                return 1;
+            }
+            bool good;
+            {
+                FdBuffer buffer(fd);
+                std::ostream out(&buffer);
+                good = checker.run(&out);
+                if(!out.flush()) good = false;
+            }
+            return ::close(fd) == 0 && good ? 0 : 1;
+        }
+        if(args[0] == "ingest" && args.size() == 2)
+        {
+            Journal journal;
+            bool use_snapshot = openDictionary(dictionary, &journal, options);
+            bool ingested = ingestAnnotations(dictionary, journal, args[1].c_str(), options.jobs);
+            closeDictionary(dictionary, journal, use_snapshot);
+            return ingested ? 0 : 1;
+        }
+        if(args[0] == "import" && (args.size() == 2 || args.size() == 3))
+        {
+            if(args.size() == 3 && args[2] != "csv" && args[2] != "tsv")
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            const std::string &path = args[1];
+            bool csv = args.size() == 3 ? args[2] == "csv" : path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+            // the words go straight into a rewritten dict, like compact
+            Journal journal;
+            bool use_snapshot = openDictionary(dictionary, &journal, options);
+            if(!importWords(dictionary, path.c_str(), csv ? import_csv : import_tsv, options.jobs)) return 1;
+            return saveDictionary(dictionary, use_snapshot) ? 0 : 1;
+        }
+        if(args[0] == "export" && (args.size() == 2 || args.size() == 3))
+        {
+            if(args.size() == 3 && args[2] != "jsonl" && args[2] != "csv")
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            const std::string &path = args[1];
+            bool csv = args.size() == 3 ? args[2] == "csv" : path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+            openDictionary(dictionary, nullptr, options);
+            return exportDictionary(dictionary, path, csv ? export_csv : export_jsonl, options.jobs) ? 0 : 1;
+        }
+        if(args[0] == "merge" && args.size() >= 3)
+        {
+            return mergeDictionaries(std::vector<std::string>(args.begin() + 2, args.end()), args[1], options.memory) ? 0 : 1;
+        }
+#ifdef VOC_BENCH
+        int status = runBench(args, options, argv[0]);
+        if(status >= 0) return status;
+#endif
+        if(args[0] == "backups" && args.size() == 1)
+        {
+            BackupStore("dict.backup").list(std::cout);
+            return 0;
+        }
+        if(args[0] == "diff" && (args.size() == 2 || args.size() == 3))
+        {
+            BackupStore store("dict.backup");
+            std::string a, b;
+            size_t gen;
+            if(!parseGeneration(args[1], gen) || !store.load(gen, a)) return 1;
+            if(args.size() == 3)
+            {
+                if(!parseGeneration(args[2], gen) || !store.load(gen, b)) return 1;
+            }
+            else
+            {
+                b = FileView("dict").view();
+            }
+            diffDictionaries(a, b, std::cout);
+            return 0;
+        }
+        if(args[0] == "restore" && args.size() == 2)
+        {
+            struct stat st;
+            finishAutosave();
+            finishSave();
+            if((stat("dict.journal", &st) == 0 && st.st_size > 0) || access(autosave_journal, F_OK) == 0)
+            {
+                std::cerr << "journal holds pending edits, run compact first." << std::endl;
+                return 1;
+            }
+            BackupStore store("dict.backup");
+            std::string content;
+            size_t gen;
+            if(!parseGeneration(args[1], gen) || !store.load(gen, content)) return 1;
+            {
+                // the current dict becomes a generation too, so restoring can be undone
+                FileView old("dict");
+                if(!old.view().empty())
+                {
+                    if(!store.store(old.view(), &gen))
+                    {
+                        std::cerr << "failed to back up dict, not restoring." << std::endl;
+                        return 1;
+                    }
+                    std::cerr << "current dict kept as generation " << gen << "." << std::endl;
+                }
+            }
+            std::ofstream out("dict.tmp", std::ios_base::binary | std::ios_base::trunc);
+            out.write(content.data(), content.size());
+            out.close();
+            return (out && rename("dict.tmp", "dict") == 0) ? 0 : 1;
+        }
+        if(args[0] == "client")
+        {
+            return runClient(options.socket.c_str(), std::vector<std::string>(args.begin() + 1, args.end()));
+        }
+        if(args[0] == "serve" && args.size() == 1)
+        {
+            // answers are plain text, clients decide how to show them
+            ConsoleColorModifier::enabled = false;
+            Journal journal;
+            bool use_snapshot = openDictionary(dictionary, &journal, options);
+            int r;
+            {
+                std::unique_ptr<Autosaver> autosaver;
+                if(options.autosave) autosaver = std::make_unique<Autosaver>(journal, std::chrono::seconds(options.autosave));
+                r = serveDictionary(dictionary, journal, options.socket.c_str(), options.jobs);
+            }
+            closeDictionary(dictionary, journal, use_snapshot);
+            return r;
+        }
+        if(args[0] == "batch" && args.size() <= 2)
+        {
+            batch_fd = args.size() > 1 ? open(args[1].c_str(), O_RDONLY) : STDIN_FILENO;
+            if(batch_fd < 0)
+            {
+                std::cerr << "cannot open '" << args[1] << "'." << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // piped or redirected input is answered in batch
+    if(batch_fd < 0 && !isatty(STDIN_FILENO)) batch_fd = STDIN_FILENO;
+
+    Journal journal;
+    bool use_snapshot = openDictionary(dictionary, &journal, options);
+
+    if(batch_fd >= 0)
+    {
+        FdBuffer buffer(STDOUT_FILENO);
+        std::ostream out(&buffer);
+        runBatch(dictionary, journal, batch_fd, out);
+        closeDictionary(dictionary, journal, use_snapshot);
+        return 0;
+    }
+
+    std::unique_ptr<Autosaver> autosaver;
+    if(options.autosave) autosaver = std::make_unique<Autosaver>(journal, std::chrono::seconds(options.autosave));
+    signal(SIGINT, signalHandler);
+    tcgetattr(STDIN_FILENO, &original_state); // get current state;
+    enableNoncanonicalInput();
+    atexit(disableNoncanonicalInput);
+
+    char c;
+    enum input_parse_state
+    {
+        wait_input,
+        read_lookup_word,
+        read_remove_word,
+        read_search_query,
+        read_category_query,
+        add_content,
+        bad_state
+    };
+    std::deque<std::pair<input_parse_state, std::vector<std::string>>> state_stack;
+    state_stack.emplace_back(std::make_pair(wait_input, std::vector<std::string>()));
+    while((c = getchar()) != '|' && c != EOF)
+    {
+    begin_loop:
+        if(state_stack.empty())
+        {
+            std::cerr << "empty state stack.\n";
+            continue;
+        }
+        if(c == '~' && state_stack.back().first != wait_input)
+        {
+            std::cerr << "reseting state.\n";
+            state_stack.pop_back();
+            continue;
+        }
+        switch(state_stack.back().first)
+        {
+            case wait_input:
+            {
+                if(isalpha(c))
+                {
+                    state_stack.emplace_back(std::make_pair(read_lookup_word, std::vector<std::string>()));
+                    std::cerr << "lookup: ";
+                    goto begin_loop; // let other section handle this char
+                }
+                if(c == '+')
+                {
+                    state_stack.emplace_back(std::make_pair(add_content, std::vector<std::string>()));
+                    std::cerr << "add: ";
+                    break;
+                }
+                if(c == '-')
+                {
+                    state_stack.emplace_back(std::make_pair(read_remove_word, std::vector<std::string>()));
+                    std::cerr << "remove: ";
+                    break;
+                }
+                if(c == '?')
+                {
+                    state_stack.emplace_back(std::make_pair(read_search_query, std::vector<std::string>()));
+                    std::cerr << "search: ";
+                    break;
+                }
+                if(c == '#')
+                {
+                    state_stack.emplace_back(std::make_pair(read_category_query, std::vector<std::string>()));
+                    std::cerr << "category: ";
+                    break;
+                }
+                break;
+            }
+            case read_lookup_word:
+            {
+                // make sure we have space to store chars
+                if(state_stack.back().second.empty()) state_stack.back().second.emplace_back();
+                auto &wdstr = state_stack.back().second[0];
+                if(c == '\n')
+                {
+                    putchar('\n');
+                    if(!wdstr.empty())
+                    {
+                        Stopwatch watch;
+                        Word *w = dictionary.find(wdstr);
+                        if(w == nullptr)
+                        {
+                            std::cerr << "word '" << HEAD(wdstr) << "' not found.\n";
+                            auto matches = suggestWords(dictionary, wdstr);
+                            if(matches.size() == 1)
+                            {
+                                std::cerr << "selecting '" << HEAD(matches[0]) << "'.\n";
+                                dictionary.find(matches[0])->print(std::cout);
+                            }
+                        }
+                        else
+                        {
+                            w->print(std::cout);
+                        }
+                        stats.latency(sc_lookup, watch.lap());
+                    }
+                    state_stack.pop_back();
                     break;
                 }
                 else if(c == 127 || c == '\b')
@@ -581,7 +7064,7 @@ int main()
                     break;
                 }
                 if(!isalpha(c)) break;
-                std::cout << HEAD(c);
+                echoKey(std::cout, FRONT_CYAN, c);
                 wdstr.push_back(c);
                 break;
             }
@@ -595,23 +7078,18 @@ int main()
                     putchar('\n');
                     if(!wdstr.empty())
                     {
-                        auto i = word_map.find(wdstr);
-                        if(i == word_map.end())
+                        Word *w = dictionary.find(wdstr);
+                        if(w == nullptr)
                         {
-                            std::cerr << "word '" << HEAD(wdstr) << "' not found." << std::endl;
-                            auto lb = word_map.lower_bound(wdstr);
-                            size_t count = 0;
-                            for(; lb != word_map.end() && lb->first.find(wdstr) == 0; ++lb, ++count)
-                            {
-                                std::cerr << "are you finding '" << HEAD(lb->first) << "'?" << std::endl;
-                            }
-                            if(count == 1) i = --lb;
+                            std::cerr << "word '" << HEAD(wdstr) << "' not found.\n";
+                            auto matches = suggestWords(dictionary, wdstr);
+                            if(matches.size() == 1) w = dictionary.find(matches[0]);
                         }
-                        if(i != word_map.end())
+                        if(w != nullptr)
                         {
-                            std::cerr << "selecting '" << HEAD(i->first) << "'." << std::endl;
-                            i->second.print(std::cout);
-                            std::cerr << "are you sure to remove '" << HEAD(i->first) << "'?" << std::endl;
+                            std::cerr << "selecting '" << HEAD(w->word) << "'.\n";
+                            w->print(std::cout);
+                            std::cerr << "are you sure to remove '" << HEAD(w->word) << "'?\n";
                             char yn, retry = 1;
                             while(retry && (yn = getchar()))
                             {
@@ -619,20 +7097,24 @@ int main()
                                 {
                                     case 'y': case 'Y':
                                     {
-                                        std::cerr << "removing '" << HEAD(i->first) << "' from dictionary." << std::endl;
-                                        word_map.erase(i);
+                                        std::cerr << "removing '" << HEAD(w->word) << "' from dictionary.\n";
+                                        Stopwatch watch;
+                                        std::string removed = w->word;
+                                        dictionary.erase(removed);
+                                        journal.remove(removed);
+                                        stats.latency(sc_remove, watch.lap());
                                         retry = 0;
                                         break;
                                     }
                                     case 'n': case 'N':
                                     {
-                                        std::cerr << "action aborted." << std::endl;
+                                        std::cerr << "action aborted.\n";
                                         retry = 0;
                                         break;
                                     }
                                     default:
                                     {
-                                        std::cerr << "please answer y/n." << std::endl;
+                                        std::cerr << "please answer y/n.\n";
                                         retry = 1;
                                         break;
                                     }
@@ -653,300 +7135,54 @@ int main()
                     break;
                 }
                 if(!isalpha(c)) break;
-                std::cout << HEAD(c);
+                echoKey(std::cout, FRONT_CYAN, c);
                 wdstr.push_back(c);
                 break;
             }
-            // todo: this section assumes that there are no errors in input
-            case add_content:
+            case read_search_query:
+            case read_category_query:
             {
-                enum add_state : char
-                {
-                    read_sentence,
-                    read_head_word,
-                    read_definition,
-                    read_collocation,
-                    read_category,
-                    read_class,
-                    bad_state
-                };
-                auto &v = state_stack.back().second;
-                enum vector_data_order : size_t
-                {
-                    vo_state,
-                    vo_sentence,
-                    vo_head_word,
-                    vo_word_class,
-                    vo_definition,
-                    vo_collocation,
-                    vo_category
-                };
-                if(v.empty())
-                {
-                    v.reserve(7);
-                    v.insert(v.end(), 7, std::string());
-                    v[vo_state].push_back(read_sentence); // reading_state
-                    v[vo_state].push_back(0); // inside_coll
-                    v[vo_state].push_back(0); // coll_only
-                }
-                auto &as = v[vo_state][0];
-                char &inside_coll = v[vo_state][1];
-                char &coll_only = v[vo_state][2];
-                // todo: multiple categories, handle backspaces
-                switch(as)
-                {
-                    case read_sentence:
-                    {
-                        if(c == ' ')
-                        {
-                            if(!v[vo_sentence].empty() && v[vo_sentence].back() != ' ')
-                            {
-                                putchar(c);
-                                v[vo_sentence].push_back(c);
-                            }
-                            break;
-                        }
-                        else if(c == '{')
-                        {
-                            putchar(c);
-                            inside_coll = true;
-                            as = read_collocation;
-                            break;
-                        }
-                        else if(c == '[')
-                        {
-                            putchar(c);
-                            as = read_head_word;
-                            break;
-                        }
-                        else if(isprint(c))
-                        {
-                            std::cout << STCE(c);
-                            v[vo_sentence].push_back(c);
-                            break;
-                        }
-                        break;
-                    }
-                    case read_head_word:
-                    {
-                        if(isalpha(c))
-                        {
-                            v[vo_sentence].push_back(c);
-                            if(inside_coll) v[vo_collocation].push_back(c);
-                            v[vo_head_word].push_back(c);
-                            std::cout << HEAD(c);
-                            break;
-                        }
-                        else if(c == '\'' && v[vo_head_word].empty())
-                        {
-                            as = read_category;
-                            putchar(c);
-                            break;
-                        }
-                        else if(c == ':' && !v[vo_head_word].empty())
-                        {
-                            as = read_definition;
-                            putchar(c);
-                            break;
-                        }
-                        else if(c == ']' && !v[vo_head_word].empty())
-                        {
-                            as = inside_coll ? read_collocation : read_sentence; // exit current state
-                            putchar(c);
-                            break;
-                        }
-                        break;
-                    }
-                    case read_category:
-                    {
-                        if(isalpha(c))
-                        {
-                            v[vo_category].push_back(c);
-                            std::cout << CATE(c);
-                            break;
-                        }
-                        else if(c == ',' && !v[vo_category].empty() && v[vo_category].back() != ',')
-                        {
-                            v[vo_category].push_back(c);
-                            putchar(c);
-                            break;
-                        }
-                        else if(c == '\'' && !v[vo_category].empty())
-                        {
-                            as = read_head_word;
-                            putchar(c);
-                            break;
-                        }
-                        break;
-                    }
-                    case read_definition:
-                    {
-                        if(c == '(')
-                        {
-                            as = read_class;
-                            putchar(c);
-                            break;
-                        }
-                        else if(c == '.')
-                        {
-                            as = read_head_word;
-                            putchar(c);
-                            break;
-                        }
-                        else if(isprint(c))
-                        {
-                            v[vo_definition].push_back(c);
-                            std::cout << DEFI(c);
-                            break;
-                        }
-                        break;
-                    }
-                    case read_collocation:
-                    {
-                        if(isalpha(c))
-                        {
-                            v[vo_collocation].push_back(c);
-                            if(!coll_only) v[vo_sentence].push_back(c);
-                            std::cout << COLL(c);
-                            break;
-                        }
-                        else if(c == ' ')
-                        {
-                            if(!v[vo_collocation].empty() && v[vo_collocation].back() != ' ')
-                            {
-                                putchar(c);
-                                v[vo_collocation].push_back(c);
-                                if(!coll_only) v[vo_sentence].push_back(c);
-                            }
-                            break;
-                        }
-                        else if(c == '[')
-                        {
-                            as = read_head_word;
-                            putchar(c);
-                            break;
-                        }
-                        else if(c == '}')
-                        {
-                            inside_coll = false;
-                            coll_only = false;
-                            as = read_sentence;
-                            putchar(c);
-                            break;
-                        }
-                        else if(c == ':' && !coll_only)
-                        {
-                            coll_only = true;
-                            putchar(c);
-                            v[vo_collocation].push_back(c);
-                        }
-                        break;
-                    }
-                    case read_class:
-                    {
-                        if(isalpha(c))
-                        {
-                            v[vo_word_class].push_back(c);
-                            std::cout << CLAS(c);
-                            break;
-                        }
-                        else if(c == ')')
-                        {
-                            as = read_definition;
-                            putchar(c);
-                            break;
-                        }
-                        break;
-                    }
-                }
+                if(state_stack.back().second.empty()) state_stack.back().second.emplace_back();
+                auto &query = state_stack.back().second[0];
                 if(c == '\n')
                 {
-                    putchar(c);
-                    if(v[vo_head_word].empty())
-                    {
-                        std::cerr << "no head word specified." << std::endl;
-                    }
-                    else
+                    putchar('\n');
+                    bool search = state_stack.back().first == read_search_query;
+                    if(!query.empty() && search) searchText(dictionary, query, std::cout);
+                    else if(!query.empty()) listCategories(dictionary, query, std::cout);
+                    state_stack.pop_back();
+                    break;
+                }
+                else if(c == 127 || c == '\b')
+                {
+                    if(!query.empty())
                     {
-                        auto &w = word_map[v[vo_head_word]];
-                        if(w.word.empty())
-                        {
-                            w.word = v[vo_head_word];
-                            std::cout << "adding word '" << HEAD(v[vo_head_word]) << "'." << std::endl;
-                        }
-                        else
-                        {
-                            std::cout << "editing word '" << HEAD(v[vo_head_word]) << "'." << std::endl;
-                        }
-                        if(!v[vo_definition].empty())
-                        {
-                            auto wcls = getWordClass(v[vo_word_class]);
-                            auto lb = w.defi.lower_bound(wcls);
-                            auto ub = w.defi.upper_bound(wcls);
-                            bool dup = false;
-                            for(; lb != ub; ++lb)
-                            {
-                                if(lb->second == v[vo_definition])
-                                {
-                                    dup = true;
-                                    break;
-                                }
-                            }
-                            if(!dup)
-                            {
-                                w.defi.insert(std::make_pair(wcls, v[vo_definition]));
-                                std::cout << "definition added: (" << CLAS(wcls) << ")" << DEFI(v[vo_definition]) << std::endl;
-                            }
-                        }
-                        if(!v[vo_collocation].empty())
-                        {
-                            w.coll.insert(v[vo_collocation]);
-                            std::cout << "collocation added: " << COLL(v[vo_collocation]) << std::endl;
-                        }
-                        if(!v[vo_category].empty())
-                        {
-                            std::vector<std::string> scs;
-                            scs.emplace_back();
-                            for(auto i = v[vo_category].begin(); i != v[vo_category].end(); ++i)
-                            {
-                                if(*i == ',') scs.emplace_back();
-                                else scs.back().push_back(*i);
-                            }
-                            for(auto &sc : scs)
-                            {
-                                if(sc.empty()) continue;
-                                w.cate.insert(sc);
-                                std::cout << "category added: " << CATE(sc) << std::endl;
-                            }
-                        }
-                        auto i = v[vo_collocation].begin();
-                        for(; i != v[vo_collocation].end() && *i != ':'; ++i);
-                        if(!v[vo_sentence].empty() &&v[vo_sentence] != std::string(v[vo_collocation].begin(), i) && v[vo_sentence] != v[vo_head_word])
-                        {
-                            w.exam.insert(v[vo_sentence]);
-                            std::cout << "example added: " << STCE(v[vo_sentence]) << std::endl;
-                        }
+                        std::cout << "\b \b";
+                        query.pop_back();
                     }
+                    break;
+                }
+                if(!isprint(c)) break;
+                putchar(c);
+                query.push_back(c);
+                break;
+            }
+            case add_content:
+            {
+                if(readAddContent(state_stack.back().second, c, std::cout))
+                {
+                    Stopwatch watch;
+                    applyAddContent(dictionary, journal, state_stack.back().second, std::cout);
+                    std::cout.flush();
+                    stats.latency(sc_add, watch.lap());
                     state_stack.pop_back();
                 }
+                break;
             }
         }
     }
 
     disableNoncanonicalInput();
-
-    size_t i = 0;
-    char name[128] = "dict.old";
-    while(std::ifstream(name))
-    {
-        sprintf(name, "dict.old.%zd", i);
-        ++i;
-    }
-    rename("dict", name);
-    file.open("dict", std::ios_base::out);
-    for(auto i = word_map.begin(); i != word_map.end(); ++i)
-    {
-        file << i->second;
-    }
-    file.close();
+    autosaver.reset();
+    closeDictionary(dictionary, journal, use_snapshot);
 }